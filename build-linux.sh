@@ -13,7 +13,7 @@ CC=${CC:-gcc}
 CXX=${CXX:-g++}
 # Add OpenCL vector extension support and define OpenCL target version
 FLAGS="-O3 -Wall -I./includes -I./libft -I./imgui -I./imgui/backends -DCL_TARGET_OPENCL_VERSION=120 -DOPENCL_C_VERSION=120"
-GL_LIBS="-lGL -lGLEW -lglfw -lm -ldl"
+GL_LIBS="-lGL -lGLEW -lglfw -lm -ldl -lpthread"
 OPENSSL_LIB="-lssl -lcrypto"
 
 # C source files
@@ -24,11 +24,25 @@ SRC_FILES=(
     "errors.c"
     "utils.c"
     "point_cloud.c"
+    "lattice.c"
+    "slab.c"
     "build_fractal.c"
     "sample_julia.c"
+    "kernels.c"
+    "orbit.c"
+    "adaptive.c"
+    "follow.c"
+    "interval.c"
+    "symmetry.c"
+    "fit.c"
+    "occupancy.c"
+    "morton.c"
+    "mesh_cache.c"
+    "stats.c"
     "polygonisation.c"
     "write_obj.c"
     "gl_draw.c"
+    "gl_profiler.c"
     "gl_utils.c"
     "gl_buffers.c"
     "gl_build.c"
@@ -16,7 +16,30 @@
 # define ASK_ITER "Please enter number of iterations: "
 
 # define ARGS "\nERROR: Invalid program arguments\n"
-# define USAGE "\nUSAGE: \n./morphosis *step_size* *q.x* *q.y* *q.z* *q.w*\n./morphosis -d\t\t\t\t\t\t| to use default values\n./morphosis -m *file_name.mat*\t\t\t\t| to read data from matrix\n./morphosis -p *file_name*\t\t\t\t| to read data from poem\n\n"
+# define USAGE "\nUSAGE: \n" \
+	"./morphosis *step_size* *q.x* *q.y* *q.z* *q.w*\n" \
+	"./morphosis -d\t\t\t\t\t\t| to use default values\n" \
+	"./morphosis -m *file_name.mat*\t\t\t\t| to read data from matrix\n" \
+	"./morphosis -p *file_name*\t\t\t\t| to read data from poem\n" \
+	"\n" \
+	"OPTIONS:\n" \
+	"--stream\t\t\t\t\t\t| keep only two z-planes of samples in memory\n" \
+	"--threads *n*\t\t\t\t\t| generate on n threads (default: one per core)\n" \
+	"--kernels *name*\t\t\t\t| baseline, avx2 or avx512 (default: best supported)\n" \
+	"--distance\t\t\t\t\t| place vertices by distance estimate, for coarser steps\n" \
+	"--refine *n*\t\t\t\t\t| bisect each crossing edge n times to place vertices\n" \
+	"--adaptive *n*\t\t\t\t| sample from n-cell bricks (n >= 2), refining near the surface\n" \
+	"--guard *n*\t\t\t\t\t| also refine n bricks around the surface (default: 1)\n" \
+	"--follow *n*\t\t\t\t\t| mesh only cells reached from seed lines n cells apart\n" \
+	"--cull *n*\t\t\t\t\t| skip n-cell bricks interval arithmetic proves in or out\n" \
+	"--symmetry\t\t\t\t\t| mesh one mirror image of a symmetric set and reflect it\n" \
+	"--fit *n*\t\t\t\t\t| fit the lattice to a pass sampling every n-th node\n" \
+	"--packed\t\t\t\t\t| keep binary samples one bit per node\n" \
+	"--morton *n*\t\t\t\t\t| mesh in n-cell bricks taken in Morton order\n" \
+	"--cache *n*\t\t\t\t\t| keep up to n MB of meshes to show again (default: 256)\n" \
+	"--gpu-log *file*\t\t\t\t| write CPU and GPU time of each frame to a CSV file\n" \
+	"--stats\t\t\t\t\t\t| profile every build, not only with the monitor open\n" \
+	"\n"
 # define NO_ARG "\nThis program calculates, displays and saves a 4d Julia set as an OBJ file in the current directory\nWhen fractal is displayed, press ESC to exit or S to save and export the mesh\n"
 
 # define BAD_FILE "\nERROR: Invalid data in the file\n\n"
@@ -18,6 +18,11 @@
 #define SRC_WIDTH 800
 #define SRC_HEIGHT 600
 
+// A preview built while a slider is held aims to take about two frames,
+// on a lattice of no fewer than this many cells across the box
+#define PREVIEW_BUDGET 0.033
+#define PREVIEW_MIN_CELLS 16
+
 void init_gl(t_gl *gl);
 t_matrix *initGlMatrices(void);
 
@@ -30,6 +35,9 @@ void terminate_gl(t_gl *gl);
 
 void createVBO(t_gl *gl, GLsizeiptr size, GLfloat *points);
 void createVAO(t_gl *gl);
+void createEBO(t_gl *gl, GLsizeiptr size, GLuint *indices);
+void gl_upload_mesh(t_data *data);
+void gl_swap_mesh(t_data *data);
 
 void makeShaderProgram(t_gl *gl);
 char *readShaderSource(char *src_name);
@@ -39,9 +47,17 @@ void createProgram(t_gl *gl);
 
 void gl_set_attrib_ptr(t_gl *gl, char *attrib_name, GLint num_vals, int stride,
                        int offset);
-void gl_retrieve_tris(t_data *data);
+int gl_retrieve_tris(t_data *data);
 
 void gl_calc_transforms(t_gl *gl);
+
+// Frame profiler
+void gl_prof_init(t_gl *gl);
+void gl_prof_frame_begin(t_gl *gl);
+void gl_prof_begin(t_gl *gl, t_pass pass);
+void gl_prof_end(t_gl *gl);
+void gl_prof_frame_end(t_gl *gl, uint indices, uint gui_vertices);
+void gl_prof_free(t_gl *gl);
 void gl_scale_tris(t_gl *gl, float3 max, float3 min);
 
 // Mouse control functions
@@ -63,6 +79,8 @@ void gui_shutdown_c();
 void gui_new_frame_c();
 void gui_render_c();
 void gui_render_all_c(t_data *data);
+int gui_vertices_c(void);
+int gl_prof_log(t_gl *gl, const char *path);
 
 #ifdef __cplusplus
 }
@@ -71,5 +89,15 @@ void gui_render_all_c(t_data *data);
 // Regeneration functions
 void regenerate_fractal(t_data *data);
 void regenerate_fractal_fast(t_data *data);
+void regenerate_fractal_async(t_data *data);
+void regen_start(t_data *data);
+void regen_stop(t_data *data);
+#ifdef __cplusplus
+extern "C" {
+#endif
+int regen_busy(t_data *data);
+#ifdef __cplusplus
+}
+#endif
 
 #endif
@@ -6,6 +6,8 @@
 #include "imgui_impl_opengl3.h"
 #include "morphosis.h"
 
+#define PERF_HISTORY 120
+
 // GUI state structure
 typedef struct {
   // Fractal parameters
@@ -33,6 +35,19 @@ typedef struct {
   bool show_fractal_controls;
   bool show_rendering_controls;
   bool show_performance_window;
+
+  // Performance history: frame times, and stage times of each build shown
+  float frame_history[PERF_HISTORY];
+  float stage_history[STAGE_COUNT][PERF_HISTORY];
+  int frame_pos;
+  int stage_pos;
+  unsigned long builds_seen;
+
+  // GPU frame times as timer queries come back, see gl_profiler.c
+  float gpu_history[PERF_HISTORY];
+  int gpu_pos;
+  unsigned long gpu_frame_seen;
+  bool log_frames;
 } t_gui_state;
 
 // Function prototypes
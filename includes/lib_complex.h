@@ -42,8 +42,10 @@ cl_complex cl_cexp(cl_complex n);
 cl_complex cl_clog(cl_complex z);
 TYPE cl_cdot(cl_complex a, cl_complex b);
 cl_quat cl_quat_mult(cl_quat q1, cl_quat q2);
+cl_quat cl_quat_square(cl_quat q);
 cl_quat cl_quat_sum(cl_quat q1, cl_quat q2);
 cl_quat cl_quat_conjugate(cl_quat q);
+TYPE cl_quat_mod2(cl_quat q);
 TYPE cl_quat_mod(cl_quat q);
 
 #endif
@@ -14,6 +14,23 @@
 #define OUTPUT_FILE "./fractal.obj"
 #define OUTPUT_PRECISION 3
 
+#define MESH_MIN_CAPACITY 1024
+#define MESH_MAX_HINT (1u << 24)
+#define MC_MAX_TRIS 5
+#define MC_MAX_VERTS 12
+#define ORBIT_MAX_NODES (1u << 22)
+#define EDGE_OBLIQUITY 1.5f
+#define REFINE_BATCH 256
+#define BRICK_MAX_LEVELS 16
+#define BRICK_SEEN 1    // corners sampled, the parent brick was refined
+#define BRICK_CROSSED 2 // corners on both sides of the surface
+#define BRICK_ACTIVE 4  // crossed or within the guard band: refine it
+#define BRICK_ESCAPES 8 // every point escapes before max_iter
+#define BRICK_BOUNDED 16 // no point escapes before max_iter
+#define INTERVAL_SLACK 1e-5
+#define EDGE_NONE 0xffffffffu
+#define MESH_CACHE_MB 256
+
 t_data *init_data(void);
 t_gl *init_gl_struct(void);
 t_julia *init_julia(void);
@@ -24,28 +41,144 @@ void init_vertex(t_data *data);
 void error(int errno, t_data *data);
 float s_size_warning(float size);
 
-float3 **arr_float3_cat(float3 **f_from, float3 **f_to, uint2 *len);
-float3 **alloc_float3_arr(float3 **mem, uint2 *len);
+void mesh_init(t_mesh *mesh);
+int mesh_reserve(t_mesh *mesh, uint extra_verts, uint extra_tris);
+void mesh_clear(t_mesh *mesh);
+void mesh_free(t_mesh *mesh);
+uint mesh_estimate(t_fract *f);
+double stats_now(void);
+double stats_clock(t_fract *f);
+double stats_add(t_fract *f, t_stage stage, double since);
+void stats_evals(t_fract *f, size_t n);
+void stats_start(t_fract *f, t_data *data);
+void stats_finish(t_fract *f, t_data *data);
+#ifdef __cplusplus
+extern "C" {
+#endif
+size_t stats_peak_rss(void);
+#ifdef __cplusplus
+}
+#endif
+void mesh_cache_init(t_mesh_cache *cache, size_t limit);
+void mesh_cache_free(t_mesh_cache *cache);
+void mesh_cache_store(t_mesh_cache *cache, t_fract *f, t_data *data);
+int mesh_cache_fetch(t_mesh_cache *cache, t_fract *f, t_data *data);
+#ifdef __cplusplus
+extern "C" {
+#endif
+void mesh_cache_limit(t_mesh_cache *cache, size_t limit);
+#ifdef __cplusplus
+}
+#endif
 
 void clean_up(t_data *data);
 void clean_gl(t_gl *gl);
 void clean_fract(t_fract *fract);
-void clean_trigs(float3 **trigs, uint len);
 void clean_calcs(t_data *data);
 
+// Samples n lattice nodes of one row: x per node, y and z shared by the row.
+// Nodes inside the set read positive, outside ones 0 or a negated distance.
+typedef void (*t_sampler)(t_julia *julia, const float *x, float y, float z,
+                          uint n, float *out);
+typedef uint (*t_classifier)(const float *lo, const float *hi, size_t row,
+                             uint n, uchar *cube, uint *active);
+typedef void (*t_orbiter)(t_julia *julia, float **z, uint *escape, uint n,
+                          uint from, uint to);
+typedef void (*t_scatter)(t_julia *julia, const float *x, const float *y,
+                          const float *z, uint n, float *out);
+
+// One instruction-set build of the numeric kernels (kernels.c)
+typedef struct s_kernels {
+  const char *name;
+  t_sampler sample_row;
+  t_classifier classify_row;
+  t_orbiter orbit_row;
+  t_sampler distance_row;
+  t_scatter sample_points;
+} t_kernels;
+
 void calculate_point_cloud(t_data *data);
 void calculate_point_cloud_optimized(t_data *data);
+void define_lattice(t_fract *fract);
 void create_grid(t_data *data);
-void subdiv_grid(float start, float stop, float step, float *axis);
-void define_voxel(t_fract *fract, float s);
+void subdiv_grid(t_fract *f, float start, float stop, uint count,
+                 float *axis);
+void define_voxel(t_fract *fract);
+void fit_lattice(t_data *data);
+
+size_t lattice_plane(t_fract *f);
+size_t lattice_nodes(t_fract *f);
+size_t lattice_index(t_fract *f, uint x, uint y);
+void sample_plane(t_fract *f, t_sampler sampler, uint z, float *val);
+void sample_lattice(t_data *data, t_sampler sampler);
+t_sampler lattice_sampler(t_fract *f);
+int lattice_adaptive(t_fract *f);
+void sample_adaptive(t_data *data, t_sampler sampler);
+void follow_surface(t_data *data, t_sampler sampler);
+void cull_bricks(t_data *data, t_sampler sampler);
+uint set_mirrors(t_fract *f, t_sampler sampler);
+uint lattice_mirrors(t_fract *f, t_sampler sampler);
+int mesh_symmetric(t_data *data, t_sampler sampler,
+                   void (*region)(t_data *, t_sampler));
+int cull_plane(t_fract *f, t_sampler sampler, uint z, float *val);
+int lattice_packed(t_fract *f);
+size_t occupancy_words(t_fract *f);
+void pack_lattice(t_data *data, t_sampler sampler, t_slab *slabs, uint n);
+uint classify_packed_row(t_fract *f, const uint64_t *bits, uint y, uint z,
+                         uchar *cube, uint *active);
+int lattice_morton(t_fract *f);
+uint morton_runs(t_fract *f);
+int polygonise_bricks(t_data *data, t_slab *slab);
+
+void orbit_init(t_orbit *orbit);
+void orbit_free(t_orbit *orbit);
+int orbit_sample(t_data *data, t_sampler sampler);
+
+uint lattice_threads(t_fract *f);
+int generation_cancelled(t_fract *f);
+uint slab_count(t_fract *f);
+t_slab *slab_split(t_data *data, uint n);
+int slab_merge(t_slab *slabs, uint n);
+void slab_free(t_slab *slabs, uint n);
 
 void build_fractal(t_data *data);
 void build_fractal_optimized(t_data *data);
+void generate_lattice(t_data *data, t_sampler sampler);
+int polygonise_lattice(t_data *data, t_slab *slab);
+int polygonise_layer(t_data *data, t_slab *slab, uint z);
+int stream_lattice(t_data *data, t_sampler sampler, t_slab *slab);
 
 float sample_4D_Julia(t_julia *julia, float3 pos);
-float sample_4D_Julia_optimized(t_julia *julia, float3 pos);
-
-float3 **polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data);
+float sample_4D_Julia_distance(t_julia *julia, float3 pos);
+float julia_distance(t_julia *julia, float mod2, float dr2, uint iter);
+void sample_4D_Julia_row(t_julia *julia, const float *x, float y, float z,
+                         uint n, float *out);
+uint classify_row(const float *lo, const float *hi, size_t row, uint n,
+                  uchar *cube, uint *active);
+void orbit_row(t_julia *julia, float **z, uint *escape, uint n, uint from,
+               uint to);
+void sample_4D_Julia_distance_row(t_julia *julia, const float *x, float y,
+                                  float z, uint n, float *out);
+void sample_4D_Julia_points(t_julia *julia, const float *x, const float *y,
+                            const float *z, uint n, float *out);
+const t_kernels *kernels_select(const char *name);
+const t_kernels *kernels_get(uint i);
+#ifdef __cplusplus
+extern "C" {
+#endif
+const char *kernels_name(void);
+#ifdef __cplusplus
+}
+#endif
+int edge_cache_init(t_edges *edges, size_t plane, uint depth);
+void edge_cache_roll(t_edges *edges, uint layers);
+void edge_cache_free(t_edges *edges);
+uint polygonise_cell(float3 *c_pos, float *c_val, uint **slots, t_mesh *mesh,
+                     uint *out);
+uint polygonise(t_fract *f, t_slab *slab, uint3 cell, uint cube);
+uint cube_faces(uint cube);
+void polygonise_row(t_fract *f, t_slab *slab, uint y, uint z);
+void refine_vertices(t_julia *julia, t_mesh *mesh, uint steps);
 
 void export_obj(t_data *data);
 void export_fractal_json(t_data *data, const char *filename);
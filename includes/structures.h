@@ -1,6 +1,9 @@
 #pragma once
 
 #include <lib_complex.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
 
 typedef struct s_matrix {
   mat4 model_mat;
@@ -22,6 +25,32 @@ typedef struct s_matrix {
   float zoom;
 } t_matrix;
 
+// Frames of GPU timer queries in flight before a result is read back
+#define FRAME_QUERIES 4
+
+// Passes of a frame timed on the GPU, see gl_profiler.c
+typedef enum e_pass { PASS_FRACTAL, PASS_GUI, PASS_COUNT } t_pass;
+
+// Frame times: the CPU's, and the GPU's from GL_TIME_ELAPSED queries kept
+// in a ring of FRAME_QUERIES frames, each read back only once available
+typedef struct s_frame_prof {
+  int timer_queries; // GL_TIME_ELAPSED is supported
+  GLuint queries[FRAME_QUERIES][PASS_COUNT];
+  int issued[FRAME_QUERIES];     // results not read back yet
+  double cpu_ms[FRAME_QUERIES];  // CPU time of the frame in each slot
+  uint indices[FRAME_QUERIES];   // fractal indices it drew
+  uint gui_verts[FRAME_QUERIES]; // ImGui vertices it drew
+  unsigned long frame;           // frames begun so far
+  double start;
+  double last_cpu_ms;            // latest frame finished
+  uint last_indices;
+  uint last_gui_verts;
+  double gpu_ms[PASS_COUNT];     // latest frame read back
+  unsigned long gpu_frame;       // frame gpu_ms belongs to
+  unsigned long dropped;         // results still pending when reused
+  FILE *csv;                     // one line per frame, NULL when off
+} t_frame_prof;
+
 typedef struct s_gl {
   GLFWwindow *window;
 
@@ -33,6 +62,9 @@ typedef struct s_gl {
 
   GLuint vbo;
   GLuint vao;
+  GLuint ebo;
+  GLuint back_vbo; // next mesh is uploaded here, then swapped with vbo
+  GLuint back_ebo;
 
   float *tris;
   uint num_pts;
@@ -42,6 +74,8 @@ typedef struct s_gl {
   // Back-reference to data for GUI integration
   struct s_data *data;
 
+  t_frame_prof prof;
+
   // Rendering state
   int wireframe_mode;
   float background_color[3];
@@ -52,7 +86,8 @@ typedef struct s_gl {
 
 typedef struct s_julia {
   uint max_iter;
-  float threshold;
+  uint exponent; // z -> z^exponent + c, at least 2
+  float threshold; // escape radius
   float w;
   cl_quat c;
 } t_julia;
@@ -63,33 +98,260 @@ typedef struct s_grid {
   float *z;
 } t_grid;
 
+// Corner of a cell expressed as a unit step on each lattice axis plus the
+// matching flat offset inside a node plane (dz selects the plane).
 typedef struct s_voxel {
-  float dx;
-  float dy;
-  float dz;
+  uint dx;
+  uint dy;
+  uint dz;
+  size_t offset;
 } t_voxel;
 
+// The lattice cut into bricks of size cells
+// per axis, the last one on each axis clipped to the lattice, for one level
+// of adaptive sampling or for interval culling
+typedef struct s_bricks {
+  uint size;
+  uint3 count;
+  uchar *state; // BRICK_* flags, x fastest then y then z
+} t_bricks;
+
+// Box of quaternions, one interval per component
+typedef struct s_interval {
+  double lo;
+  double hi;
+} t_interval;
+
+typedef struct s_iquat {
+  t_interval x;
+  t_interval y;
+  t_interval z;
+  t_interval w;
+} t_iquat;
+
+// Stages of a build, in pipeline order, see stats.c
+typedef enum e_stage {
+  STAGE_SAMPLE,   // Julia evaluations, refinement included
+  STAGE_CLASSIFY, // cube indices and crossed cell lists
+  STAGE_EMIT,     // triangles and vertices of crossed cells
+  STAGE_MERGE,    // slab meshes and mirror images joined into one
+  STAGE_RETRIEVE, // vertices copied out for drawing, gl_retrieve_tris
+  STAGE_UPLOAD,   // vertex and index buffers handed to GL
+  STAGE_COUNT
+} t_stage;
+
+// What the last build shown cost. Stage times are summed over the threads
+// running them, so they can add up to more than the wall time.
+typedef struct s_stats {
+  unsigned long long ns[STAGE_COUNT];
+  unsigned long long evals; // nodes or points handed to a Julia sampler
+  unsigned long allocs;     // mesh buffers allocated or grown
+  size_t lattice_bytes;     // samples held during the build
+  uint tris;
+  double seconds; // wall time of generation, sampling through merging
+  unsigned long builds; // builds shown so far
+} t_stats;
+
 typedef struct s_fract {
   float3 p0;
   float3 p1;
   float step_size;
   float grid_length;
   float grid_size;
+  uint3 cells; // cells per axis, the lattice has cells + 1 nodes per axis
+  int stream;  // sample two z-planes at a time instead of the whole lattice
+  uint threads; // worker threads for generation, 0 uses one per core
+  int distance; // sample a distance estimate so vertices land between nodes
+  uint refine;  // bisection steps along each crossing edge, 0 for none
+  uint brick;   // adaptive sampling from bricks this many cells wide, 0 off
+  uint guard;   // bricks around each crossed one also refined
+  uint follow;  // seed line spacing for surface-following meshing, 0 off
+  uint cull;    // brick size for interval culling, 0 off
+  int symmetry; // mesh one mirror image of a symmetric set and reflect it
+  uint fit;     // narrow the lattice to a pass sampling every fit-th node
+  int packed;   // binary samples kept one bit per node instead of a float
+  uint morton;  // mesh in bricks this many cells wide, in Morton order, 0 off
+  int orbits;   // keep orbits so max_iter can change without resampling
+  int *cancel;  // set by another thread to abandon the build, NULL for none
+  t_stats *stats; // stage times and counts of the build, NULL for none
 
   t_julia *julia;
   t_grid grid;
   t_voxel voxel[8];
+  t_bricks culled; // interval verdict of each brick, state NULL when off
 } t_fract;
 
+typedef struct s_mesh {
+  float3 *verts; // unique vertices, shared by every triangle touching them
+  float3 *ends;  // outside end of each vertex's edge, while keep_ends is set
+  uchar *faces;  // lattice faces at 0 holding each vertex's edge, bit 0 for
+                 // x, while keep_faces is set
+  uint *idx;     // three vertex indices per triangle
+  uint num_verts;
+  uint num_tris;
+  uint vert_capacity;
+  uint end_capacity;
+  uint face_capacity;
+  uint tri_capacity;
+  int keep_ends;  // vertices sit on their inside node until refined
+  int keep_faces; // vertices record the lattice faces their edges lie in
+  unsigned long allocs; // buffers allocated or grown, with merged slabs'
+} t_mesh;
+
+// Vertex index already created on each lattice edge of the current run of
+// depth layers of cells: x and y edges of its lowest node plane [0] and of
+// the depth planes above it [1], and the z edges of each layer. Entries are
+// indexed like the node they start from, a plane apart per layer.
+typedef struct s_edges {
+  uint *x[2];
+  uint *y[2];
+  uint *z;
+  size_t plane;
+  uint depth; // layers of cells held, 1 unless meshing in bricks
+  uint layer; // layer of the run the cells being meshed lie in
+} t_edges;
+
+// Growable list of lattice cell or node indices
+typedef struct s_indices {
+  size_t *at;
+  size_t len;
+  size_t cap;
+} t_indices;
+
+// Surface-following state: one bit per node already sampled and per cell
+// already reached, the cells to classify in this wave and the next, and the
+// cells found crossed so far
+typedef struct s_follow {
+  uchar *sampled;
+  uchar *reached;
+  t_indices wave;
+  t_indices next;
+  t_indices nodes;
+  t_indices surface;
+} t_follow;
+
+// Run of layers of cells [z0, z1) meshed on its own thread. Slab 0 writes
+// straight into the final mesh, later slabs into their own and are appended
+// in order once every slab is done.
+typedef struct s_slab {
+  uint z0;
+  uint z1;
+  float *planes[2];
+  const uint64_t *bits; // packed occupancy of the lattice, NULL for floats
+  t_edges edges;
+  uchar *cubes; // cube index of each cell of the current row, or run
+  uint *active; // cells of the current row the surface crosses
+  t_mesh *mesh;
+  t_mesh own;
+} t_slab;
+
+// Parameters a t_orbit belongs to, all 4-byte fields so it compares with
+// memcmp
+typedef struct s_orbit_key {
+  float p0[3]; // first node, which moves with the meshed part of the lattice
+  float step;
+  uint cells[3];
+  float c[4];
+  float w;
+  float threshold;
+  uint exponent;
+} t_orbit_key;
+
+// Iteration state of every lattice node kept between generations, so a
+// change of max_iter alone continues or reuses earlier iterations.
+typedef struct s_orbit {
+  t_orbit_key key;
+  uint iters; // iterations computed so far
+  size_t nodes;
+  float *z[4];  // last z of nodes still bounded, one array per component
+  uint *escape; // iteration a node escaped at, 0 while still bounded
+} t_orbit;
+
+// Parameters a finished mesh was built from, all 4-byte fields so it
+// compares with memcmp. Options that only change the order of triangles are
+// part of it too, so a cached mesh is exactly what its build would make.
+typedef struct s_mesh_key {
+  float c[4];
+  float w;
+  float threshold;
+  uint exponent;
+  uint max_iter;
+  float step;
+  float p0[3];
+  float p1[3];
+  int distance;
+  uint refine;
+  uint brick;
+  uint guard;
+  uint follow;
+  uint cull;
+  int symmetry;
+  uint fit;
+  uint morton;
+} t_mesh_key;
+
+// A mesh shown before: its vertices and triangles as built, for export, and
+// the positions uploaded for drawing
+typedef struct s_cached_mesh {
+  t_mesh_key key;
+  t_mesh mesh;
+  float *tris;
+  uint num_pts;
+  t_grid grid; // lattice axes the mesh was built on
+  uint3 cells;
+  float grid_size;
+  size_t bytes;
+  unsigned long used; // tick of the last store or hit, the oldest goes first
+} t_cached_mesh;
+
+// Finished meshes by parameters, the least recently used dropped past limit
+typedef struct s_mesh_cache {
+  t_cached_mesh *entries;
+  uint len;
+  uint cap;
+  size_t bytes;
+  size_t limit; // bytes held at most, 0 caches nothing
+  unsigned long tick;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+} t_mesh_cache;
+
+// Background regeneration: a worker thread builds into its own t_data while
+// the GL thread keeps drawing the current mesh. Every field but thread and
+// back is guarded by lock.
+typedef struct s_regen {
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+  struct s_data *back; // worker's parameters, samples, mesh and orbit cache
+  t_fract want;        // parameters of the latest request
+  t_julia julia;
+  int pending;      // want holds a request the worker has not taken yet
+  int want_preview; // the request is a preview, which other previews wait for
+  int busy;         // a build is in progress
+  int preview;      // the build in progress is one, or the last finished
+  double seconds;   // time the last finished build took
+  int ready;        // back holds a finished build not shown yet
+  int cancel;       // the build in progress is stale, read by it unlocked
+  int quit;
+} t_regen;
+
 typedef struct s_data {
   t_gl *gl;
   t_fract *fract;
-  float3 *vertexpos;
-  float *vertexval;
-  float3 **triangles;
-
-  uint2 len;
+  float *vertexval; // lattice node samples, x fastest then y then z
+  uint64_t *occupied; // one bit per node while packed, see occupancy.c
+  t_mesh mesh;
+  t_orbit orbit;
+  t_mesh_cache cache;
+  t_stats stats;
+  int profile; // --stats: time every build, not just with the monitor open
 
   // GUI and regeneration support
   int needs_regeneration;
+  int preview;          // regenerate coarsely, a parameter slider being held
+  double build_seconds; // time and step of the last build shown
+  float build_step;
+  t_regen *regen; // background worker, NULL to regenerate inline
 } t_data;
@@ -0,0 +1,273 @@
+#include "morphosis.h"
+
+// Adaptive sampling: the lattice is first sampled every few nodes, then
+// refined level by level only inside bricks whose corners disagree, plus a
+// guard band of bricks around them so thin features next to the surface are
+// not lost. Nodes never sampled take the value of the uniform brick holding
+// them. Meshing still runs on the one finest lattice, so bricks of different
+// sizes meet without cracks.
+
+#define NODE_QUEUED INFINITY
+
+// Nodes along an axis at stride h: every multiple of h below cells, then
+// cells itself
+static uint axis_nodes(uint cells, uint h) { return (cells + h - 1) / h + 1; }
+
+static uint axis_node(uint k, uint h, uint cells) {
+  return k * h < cells ? k * h : cells;
+}
+
+static size_t node_at(t_fract *f, uint x, uint y, uint z) {
+  return ((size_t)z * (f->cells.y + 1) + y) * (f->cells.x + 1) + x;
+}
+
+static void queue_node(t_data *data, uchar *rows, uint x, uint y, uint z) {
+  t_fract *f = data->fract;
+  size_t i = node_at(f, x, y, z);
+
+  if (isnan(data->vertexval[i])) {
+    data->vertexval[i] = NODE_QUEUED;
+    rows[(size_t)z * (f->cells.y + 1) + y] = 1;
+  }
+}
+
+// Samples every queued node at stride h, row by row so the row samplers see
+// them in SIMD batches
+static void sample_queued(t_data *data, t_sampler sampler, uint h,
+                          uchar *rows) {
+  t_fract *f = data->fract;
+  uint nx = axis_nodes(f->cells.x, h);
+  uint nz = axis_nodes(f->cells.z, h);
+  float *xs;
+  float *out;
+  uint *at;
+
+  xs = (float *)malloc((size_t)nz * nx * sizeof(float));
+  out = (float *)malloc((size_t)nz * nx * sizeof(float));
+  at = (uint *)malloc((size_t)nz * nx * sizeof(uint));
+  if (!xs || !out || !at)
+    error(MALLOC_FAIL_ERR, data);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f))
+#endif
+  for (uint kz = 0; kz < nz; kz++) {
+    uint z = axis_node(kz, h, f->cells.z);
+    float *px = xs + (size_t)kz * nx;
+    float *po = out + (size_t)kz * nx;
+    uint *pa = at + (size_t)kz * nx;
+
+    for (uint ky = 0; ky < axis_nodes(f->cells.y, h); ky++) {
+      uint y = axis_node(ky, h, f->cells.y);
+      float *val = data->vertexval + node_at(f, 0, y, z);
+      uint n = 0;
+
+      if (!rows[(size_t)z * (f->cells.y + 1) + y])
+        continue;
+      rows[(size_t)z * (f->cells.y + 1) + y] = 0;
+      for (uint kx = 0; kx < nx; kx++) {
+        uint x = axis_node(kx, h, f->cells.x);
+        if (val[x] == NODE_QUEUED) {
+          px[n] = f->grid.x[x];
+          pa[n++] = x;
+        }
+      }
+      if (n) {
+        double start = stats_clock(f);
+
+        sampler(f->julia, px, f->grid.y[y], f->grid.z[z], n, po);
+        stats_add(f, STAGE_SAMPLE, start);
+        stats_evals(f, n);
+      }
+      for (uint i = 0; i < n; i++)
+        val[pa[i]] = po[i];
+    }
+  }
+  free(xs);
+  free(out);
+  free(at);
+}
+
+static size_t brick_at(t_bricks *lv, uint x, uint y, uint z) {
+  return ((size_t)z * lv->count.y + y) * lv->count.x + x;
+}
+
+static void brick_span(uint b, uint size, uint cells, uint *lo, uint *hi) {
+  *lo = b * size;
+  *hi = *lo + size < cells ? *lo + size : cells;
+}
+
+// Bricks inside an active parent are seen; those with corners on both sides
+// of the surface are crossed
+static void classify_bricks(t_data *data, t_bricks *lv, t_bricks *parent) {
+  t_fract *f = data->fract;
+  uint lo[3];
+  uint hi[3];
+  uint inside;
+
+  for (uint bz = 0; bz < lv->count.z; bz++) {
+    for (uint by = 0; by < lv->count.y; by++) {
+      for (uint bx = 0; bx < lv->count.x; bx++) {
+        if (parent && !(parent->state[brick_at(parent, bx / 2, by / 2,
+                                               bz / 2)] &
+                        BRICK_ACTIVE))
+          continue;
+        brick_span(bx, lv->size, f->cells.x, lo, hi);
+        brick_span(by, lv->size, f->cells.y, lo + 1, hi + 1);
+        brick_span(bz, lv->size, f->cells.z, lo + 2, hi + 2);
+        inside = 0;
+        for (uint c = 0; c < 8; c++)
+          inside += data->vertexval[node_at(f, c & 1 ? hi[0] : lo[0],
+                                            c & 2 ? hi[1] : lo[1],
+                                            c & 4 ? hi[2] : lo[2])] > 0.0f;
+        lv->state[brick_at(lv, bx, by, bz)] =
+            BRICK_SEEN | (inside && inside < 8 ? BRICK_CROSSED : 0);
+      }
+    }
+  }
+}
+
+// Every seen brick within guard bricks of a crossed one is refined
+static void guard_bricks(t_bricks *lv, int guard) {
+  int n[3] = {(int)lv->count.x, (int)lv->count.y, (int)lv->count.z};
+  uchar *s;
+
+  for (int bz = 0; bz < n[2]; bz++)
+    for (int by = 0; by < n[1]; by++)
+      for (int bx = 0; bx < n[0]; bx++) {
+        if (!(lv->state[brick_at(lv, bx, by, bz)] & BRICK_CROSSED))
+          continue;
+        for (int z = bz - guard; z <= bz + guard; z++)
+          for (int y = by - guard; y <= by + guard; y++)
+            for (int x = bx - guard; x <= bx + guard; x++) {
+              if (x < 0 || y < 0 || z < 0 || x >= n[0] || y >= n[1] ||
+                  z >= n[2])
+                continue;
+              s = lv->state + brick_at(lv, x, y, z);
+              if (*s & BRICK_SEEN)
+                *s |= BRICK_ACTIVE;
+            }
+      }
+}
+
+// Queues the nodes an active brick gains at half its size: the midpoints of
+// its edges and faces and its centre
+static void queue_bricks(t_data *data, t_bricks *lv, uchar *rows) {
+  t_fract *f = data->fract;
+  uint h = lv->size / 2;
+  uint p[3][3];
+  uint m[3];
+  uint lo;
+  uint hi;
+
+  for (uint bz = 0; bz < lv->count.z; bz++) {
+    for (uint by = 0; by < lv->count.y; by++) {
+      for (uint bx = 0; bx < lv->count.x; bx++) {
+        if (!(lv->state[brick_at(lv, bx, by, bz)] & BRICK_ACTIVE))
+          continue;
+        for (uint a = 0; a < 3; a++) {
+          brick_span(a == 0 ? bx : a == 1 ? by : bz, lv->size,
+                     a == 0 ? f->cells.x : a == 1 ? f->cells.y : f->cells.z,
+                     &lo, &hi);
+          m[a] = 0;
+          p[a][m[a]++] = lo;
+          if (lo + h < hi)
+            p[a][m[a]++] = lo + h;
+          p[a][m[a]++] = hi;
+        }
+        for (uint k = 0; k < m[2]; k++)
+          for (uint j = 0; j < m[1]; j++)
+            for (uint i = 0; i < m[0]; i++)
+              if ((i > 0 && i + 1 < m[0]) || (j > 0 && j + 1 < m[1]) ||
+                  (k > 0 && k + 1 < m[2]))
+                queue_node(data, rows, p[0][i], p[1][j], p[2][k]);
+      }
+    }
+  }
+}
+
+// Bricks seen but not refined are uniform: each fills the nodes it owns
+// that were never sampled with its first corner's value. A brick owns the
+// nodes of its span up to but excluding its upper faces, except at the end
+// of the lattice, so bricks of a level never share a node.
+static void fill_bricks(t_data *data, t_bricks *lv) {
+  t_fract *f = data->fract;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f))
+#endif
+  for (uint bz = 0; bz < lv->count.z; bz++) {
+    uint lo[3];
+    uint end[3];
+    float *val;
+    float v;
+
+    for (uint by = 0; by < lv->count.y; by++) {
+      for (uint bx = 0; bx < lv->count.x; bx++) {
+        if ((lv->state[brick_at(lv, bx, by, bz)] &
+             (BRICK_SEEN | BRICK_ACTIVE)) != BRICK_SEEN)
+          continue;
+        brick_span(bx, lv->size, f->cells.x, lo, end);
+        brick_span(by, lv->size, f->cells.y, lo + 1, end + 1);
+        brick_span(bz, lv->size, f->cells.z, lo + 2, end + 2);
+        end[0] += bx + 1 == lv->count.x;
+        end[1] += by + 1 == lv->count.y;
+        end[2] += bz + 1 == lv->count.z;
+        v = data->vertexval[node_at(f, lo[0], lo[1], lo[2])];
+        for (uint z = lo[2]; z < end[2]; z++)
+          for (uint y = lo[1]; y < end[1]; y++) {
+            val = data->vertexval + node_at(f, 0, y, z);
+            for (uint x = lo[0]; x < end[0]; x++)
+              if (isnan(val[x]))
+                val[x] = v;
+          }
+      }
+    }
+  }
+}
+
+// Bricks of one cell would sample every node anyway, so adaptive sampling
+// starts at two; streaming never holds the lattice it fills
+int lattice_adaptive(t_fract *f) { return f->brick >= 2 && !f->stream; }
+
+void sample_adaptive(t_data *data, t_sampler sampler) {
+  t_fract *f = data->fract;
+  t_bricks levels[BRICK_MAX_LEVELS];
+  uchar *rows;
+  uint size;
+  uint n;
+
+  size = 2;
+  while (size * 2 <= f->brick && size < (1u << (BRICK_MAX_LEVELS - 1)))
+    size *= 2;
+  memset(data->vertexval, 0xff, lattice_nodes(f) * sizeof(float));
+  if (!(rows = (uchar *)calloc((size_t)(f->cells.y + 1) * (f->cells.z + 1),
+                               1)))
+    error(MALLOC_FAIL_ERR, data);
+  for (uint kz = 0; kz < axis_nodes(f->cells.z, size); kz++)
+    for (uint ky = 0; ky < axis_nodes(f->cells.y, size); ky++)
+      for (uint kx = 0; kx < axis_nodes(f->cells.x, size); kx++)
+        queue_node(data, rows, axis_node(kx, size, f->cells.x),
+                   axis_node(ky, size, f->cells.y),
+                   axis_node(kz, size, f->cells.z));
+  sample_queued(data, sampler, size, rows);
+  for (n = 0; size >= 2; size /= 2, n++) {
+    levels[n].size = size;
+    levels[n].count.x = (f->cells.x + size - 1) / size;
+    levels[n].count.y = (f->cells.y + size - 1) / size;
+    levels[n].count.z = (f->cells.z + size - 1) / size;
+    if (!(levels[n].state = (uchar *)calloc((size_t)levels[n].count.x *
+                                                levels[n].count.y *
+                                                levels[n].count.z,
+                                            1)))
+      error(MALLOC_FAIL_ERR, data);
+    classify_bricks(data, levels + n, n ? levels + n - 1 : NULL);
+    guard_bricks(levels + n, (int)f->guard);
+    queue_bricks(data, levels + n, rows);
+    sample_queued(data, sampler, size / 2, rows);
+  }
+  for (uint l = 0; l < n; l++) {
+    fill_bricks(data, levels + l);
+    free(levels[l].state);
+  }
+  free(rows);
+}
@@ -1,46 +1,160 @@
 #include "morphosis.h"
 
-void						build_fractal(t_data *data)
+/*
+** Meshing runs on the slab threads, which must not exit the process, so a
+** layer that cannot grow its mesh returns 0 and stops its slab; mesh_slabs
+** raises the error once every thread is done.
+*/
+
+int							polygonise_layer(t_data *data, t_slab *slab, uint z)
+{
+	t_fract 				*f;
+
+	f = data->fract;
+	for (uint y = 0; y < f->cells.y; y++)
+	{
+		if (!mesh_reserve(slab->mesh, f->cells.x * MC_MAX_VERTS,
+			f->cells.x * MC_MAX_TRIS))
+			return (0);
+		polygonise_row(f, slab, y, z);
+	}
+	edge_cache_roll(&slab->edges, 1);
+	return (1);
+}
+
+int							polygonise_lattice(t_data *data, t_slab *slab)
+{
+	t_fract 				*f;
+
+	f = data->fract;
+	for (uint z = slab->z0; z < slab->z1 && !generation_cancelled(f); z++)
+	{
+		if (!slab->bits)
+		{
+			slab->planes[0] = data->vertexval + z * lattice_plane(f);
+			slab->planes[1] = slab->planes[0] + lattice_plane(f);
+		}
+		if (!polygonise_layer(data, slab, z))
+			return (0);
+	}
+	return (1);
+}
+
+/*
+** Two-slab rolling buffer: plane z + 1 is sampled into the slot that held
+** plane z - 1, so memory stays O(n^2) however fine the step size gets. Each
+** slab rolls through its own pair of planes.
+*/
+
+int							stream_lattice(t_data *data, t_sampler sampler,
+								t_slab *slab)
 {
 	t_fract 				*f;
-	float3 					**new_tris;
-	size_t 					i;
-	uint2					pos;
+	float					*tmp;
 
-	i = 0;
 	f = data->fract;
-	data->len.x = 0;
-	data->len.y = 0;
-	pos.x = 0;
-	pos.y = 0;
-	new_tris = NULL;
-	
-	for (size_t z = 0; z < f->grid_size; z++)
+	sample_plane(f, sampler, slab->z0, slab->planes[0]);
+	for (uint z = slab->z0; z < slab->z1 && !generation_cancelled(f); z++)
+	{
+		sample_plane(f, sampler, z + 1, slab->planes[1]);
+		if (!polygonise_layer(data, slab, z))
+			return (0);
+		tmp = slab->planes[0];
+		slab->planes[0] = slab->planes[1];
+		slab->planes[1] = tmp;
+	}
+	return (1);
+}
+
+/*
+** Vertices are welded while meshing: the edge cache remembers which vertex
+** sits on each lattice edge of the current layer, so neighbouring cells share
+** it instead of emitting a copy. Slabs of layers are meshed, and their
+** vertices refined, in parallel and merged in z order, which gives the same
+** mesh whatever the thread count. Surface following skips the slabs and
+** meshes only the cells it reached. A symmetric set is meshed over one
+** mirror image of the lattice and reflected. Brick order meshes each slab a
+** brick at a time instead of a row at a time. A cancelled build stops after
+** sampling or between layers and leaves no mesh, since slabs cut short
+** cannot be merged.
+*/
+
+static void					mesh_slabs(t_data *data, t_sampler sampler)
+{
+	t_slab					*slabs;
+	double					start;
+	uint					n;
+	int						failed;
+
+	n = slab_count(data->fract);
+	failed = 0;
+	if (!(slabs = slab_split(data, n)))
+		error(MALLOC_FAIL_ERR, data);
+	cull_bricks(data, sampler);
+	if (lattice_adaptive(data->fract))
+		sample_adaptive(data, sampler);
+	else if (lattice_packed(data->fract))
+		pack_lattice(data, sampler, slabs, n);
+	else if (!data->fract->stream && !orbit_sample(data, sampler))
+		sample_lattice(data, sampler);
+	if (generation_cancelled(data->fract))
 	{
-		printf("%zu/%.0f\n", (z + 1), f->grid_size);
-        for (size_t y = 0; y < f->grid_size; y++)
+		slab_free(slabs, n);
+		return ;
+	}
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(n) private(start)
+#endif
+	for (uint c = 0; c < n; c++)
+	{
+		if (!(data->fract->stream ? stream_lattice(data, sampler, slabs + c)
+			: lattice_morton(data->fract) ? polygonise_bricks(data, slabs + c)
+			: polygonise_lattice(data, slabs + c)))
 		{
-            for (size_t x = 0; x < f->grid_size; x++)
-			{
-                for (int c = 0; c < 8; c++)
-				{
-					data->vertexpos[i].x = f->grid.x[x] + f->voxel[c].dx;
-					data->vertexpos[i].y = f->grid.y[y] + f->voxel[c].dy;
-					data->vertexpos[i].z = f->grid.z[z] + f->voxel[c].dz;
-					data->vertexval[i] = sample_4D_Julia(f->julia, data->vertexpos[i]);
-					i++;
-				}
-				pos.y += 8;
-				new_tris = polygonise(data->vertexpos, data->vertexval, &pos, data);
-				if (new_tris)
-				{
-					if (!(data->triangles = arr_float3_cat(new_tris, data->triangles, &data->len)))
-						error(MALLOC_FAIL_ERR, data);
-				}
-				pos.x = pos.y;
-			}
+			__atomic_store_n(&failed, 1, __ATOMIC_RELAXED);
+			continue ;
 		}
+		if (data->fract->refine)
+		{
+			start = stats_clock(data->fract);
+			refine_vertices(data->fract->julia, slabs[c].mesh,
+				data->fract->refine);
+			stats_add(data->fract, STAGE_SAMPLE, start);
+			stats_evals(data->fract,
+				(size_t)slabs[c].mesh->num_verts * data->fract->refine);
+		}
+	}
+	start = stats_clock(data->fract);
+	if (failed || (!generation_cancelled(data->fract)
+		&& !slab_merge(slabs, n)))
+	{
+		slab_free(slabs, n);
+		error(MALLOC_FAIL_ERR, data);
 	}
-	data->gl->num_tris = data->len.x;
-	data->gl->num_pts = data->len.x * 3 * 3;
+	stats_add(data->fract, STAGE_MERGE, start);
+	slab_free(slabs, n);
+}
+
+static void					mesh_region(t_data *data, t_sampler sampler)
+{
+	if (!data->fract->stream && data->fract->follow)
+		follow_surface(data, sampler);
+	else
+		mesh_slabs(data, sampler);
+}
+
+void						generate_lattice(t_data *data, t_sampler sampler)
+{
+	mesh_clear(&data->mesh);
+	if (!mesh_symmetric(data, sampler, mesh_region))
+		mesh_region(data, sampler);
+	if (generation_cancelled(data->fract))
+		mesh_clear(&data->mesh);
+	data->gl->num_tris = data->mesh.num_tris;
+	data->gl->num_pts = data->mesh.num_verts * 3;
+}
+
+void						build_fractal(t_data *data)
+{
+	generate_lattice(data, lattice_sampler(data->fract));
 }
@@ -2,13 +2,13 @@
 
 void 						clean_calcs(t_data *data)
 {
-	if (data->vertexpos && data->vertexval)
+	if (data->vertexval)
 	{
 		free(data->vertexval);
-		free(data->vertexpos);
 		data->vertexval = NULL;
-		data->vertexpos = NULL;
 	}
+	free(data->occupied);
+	data->occupied = NULL;
 }
 
 void 						clean_fract(t_fract *fract)
@@ -23,6 +23,7 @@ void 						clean_fract(t_fract *fract)
 		free(fract->grid.y);
 	if (fract->grid.z)
 		free(fract->grid.z);
+	free(fract->culled.state);
 	free(fract);
 }
 
@@ -35,13 +36,6 @@ void						clean_gl(t_gl *gl)
 	free(gl);
 }
 
-void						clean_trigs(float3 **trigs, uint len)
-{
-	for (uint i = 0; i < len; i++)
-		free(trigs[i]);
-	free(trigs);
-}
-
 void 						clean_up(t_data *data)
 {
 	if (data)
@@ -50,12 +44,12 @@ void 						clean_up(t_data *data)
 			clean_gl(data->gl);
 		if (data->fract)
 			clean_fract(data->fract);
-		if (data->vertexpos)
-			free(data->vertexpos);
 		if (data->vertexval)
 			free(data->vertexval);
-		if (data->triangles)
-			clean_trigs(data->triangles, data->len.x);
+		free(data->occupied);
+		mesh_free(&data->mesh);
+		orbit_free(&data->orbit);
+		mesh_cache_free(&data->cache);
 		free(data);
 	}
 }
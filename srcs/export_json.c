@@ -2,9 +2,11 @@
 
 void export_fractal_json(t_data *data, const char *filename) {
   FILE *file;
-  int i;
+  float3 *v;
+  uint *tri;
+  uint i;
 
-  if (!data || !data->triangles || !filename) {
+  if (!data || !data->mesh.verts || !filename) {
     printf("Error: Invalid data or filename for JSON export\n");
     return;
   }
@@ -20,8 +22,8 @@ void export_fractal_json(t_data *data, const char *filename) {
   // Write JSON header
   fprintf(file, "{\n");
   fprintf(file, "  \"metadata\": {\n");
-  fprintf(file, "    \"triangleCount\": %d,\n", data->len.x);
-  fprintf(file, "    \"vertexCount\": %d,\n", data->len.x * 3);
+  fprintf(file, "    \"triangleCount\": %u,\n", data->mesh.num_tris);
+  fprintf(file, "    \"vertexCount\": %u,\n", data->mesh.num_verts);
   fprintf(file, "    \"iterations\": %d,\n", data->fract->julia->max_iter);
   fprintf(file, "    \"gridSize\": %.0f,\n", data->fract->grid_size);
   fprintf(file, "    \"stepSize\": %f,\n", data->fract->step_size);
@@ -32,28 +34,22 @@ void export_fractal_json(t_data *data, const char *filename) {
 
   // Write vertices array (flattened for web consumption)
   fprintf(file, "  \"vertices\": [\n");
-  for (i = 0; i < data->len.x; i++) {
-    // Each triangle has 3 vertices
-    fprintf(file, "    %f, %f, %f", data->triangles[i][0].x,
-            data->triangles[i][0].y, data->triangles[i][0].z);
-    fprintf(file, ",\n");
-    fprintf(file, "    %f, %f, %f", data->triangles[i][1].x,
-            data->triangles[i][1].y, data->triangles[i][1].z);
-    fprintf(file, ",\n");
-    fprintf(file, "    %f, %f, %f", data->triangles[i][2].x,
-            data->triangles[i][2].y, data->triangles[i][2].z);
-    if (i < data->len.x - 1) {
+  for (i = 0; i < data->mesh.num_verts; i++) {
+    v = data->mesh.verts + i;
+    fprintf(file, "    %f, %f, %f", v->x, v->y, v->z);
+    if (i < data->mesh.num_verts - 1) {
       fprintf(file, ",");
     }
     fprintf(file, "\n");
   }
   fprintf(file, "  ],\n");
 
-  // Write indices array (each triangle has 3 vertices)
+  // Write indices array (vertices are shared between triangles)
   fprintf(file, "  \"indices\": [\n");
-  for (i = 0; i < data->len.x; i++) {
-    fprintf(file, "    %d, %d, %d", i * 3, i * 3 + 1, i * 3 + 2);
-    if (i < data->len.x - 1) {
+  for (i = 0; i < data->mesh.num_tris; i++) {
+    tri = data->mesh.idx + (size_t)i * 3;
+    fprintf(file, "    %u, %u, %u", tri[0], tri[1], tri[2]);
+    if (i < data->mesh.num_tris - 1) {
       fprintf(file, ",");
     }
     fprintf(file, "\n");
@@ -64,5 +60,5 @@ void export_fractal_json(t_data *data, const char *filename) {
   fprintf(file, "}\n");
 
   fclose(file);
-  printf("JSON export complete: %d triangles exported\n", data->len.x);
+  printf("JSON export complete: %u triangles exported\n", data->mesh.num_tris);
 }
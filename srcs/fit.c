@@ -0,0 +1,102 @@
+#include "morphosis.h"
+
+// Auto-fitting: before the full build, every fit-th node of the box's
+// lattice samples the distance estimate, and each axis of the lattice is
+// narrowed to the span of the nodes inside the set or within half a coarse
+// cell's diagonal of it, padded by one coarse cell on each side. Every
+// point of a coarse cell is that close to one of its corners, so thin parts
+// of the set passing between coarse nodes are kept. The nodes kept are
+// the very nodes the whole box would sample, and the mesh is unchanged
+// unless the estimate misses a piece of the set.
+
+static uint coarse_nodes(uint cells, uint h) { return (cells + h - 1) / h + 1; }
+
+static uint coarse_node(uint k, uint h, uint cells) {
+  return k * h < cells ? k * h : cells;
+}
+
+// Coarse index span of the nodes near the set, lo above hi when none is
+static void coarse_span(t_fract *f, uint h, uint *lo, uint *hi, float *xs,
+                        float *out) {
+  float reach = 0.5f * sqrtf(3.0f) * (float)h * (f->grid.x[1] - f->grid.x[0]);
+  uint n[3] = {coarse_nodes(f->cells.x, h), coarse_nodes(f->cells.y, h),
+               coarse_nodes(f->cells.z, h)};
+  uint lx = n[0], ly = n[1], lz = n[2];
+  uint hx = 0, hy = 0, hz = 0;
+
+  for (uint kx = 0; kx < n[0]; kx++)
+    xs[kx] = f->grid.x[coarse_node(kx, h, f->cells.x)];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f)) \
+    reduction(min : lx, ly, lz) reduction(max : hx, hy, hz)
+#endif
+  for (uint kz = 0; kz < n[2]; kz++) {
+    float *row = out + (size_t)kz * n[0];
+
+    for (uint ky = 0; ky < n[1]; ky++) {
+      sample_4D_Julia_distance_row(f->julia, xs,
+                                   f->grid.y[coarse_node(ky, h, f->cells.y)],
+                                   f->grid.z[coarse_node(kz, h, f->cells.z)],
+                                   n[0], row);
+      for (uint kx = 0; kx < n[0]; kx++) {
+        if (!(row[kx] > -reach))
+          continue;
+        lx = kx < lx ? kx : lx;
+        hx = kx > hx ? kx : hx;
+        ly = ky < ly ? ky : ly;
+        hy = ky > hy ? ky : hy;
+        lz = kz < lz ? kz : lz;
+        hz = kz > hz ? kz : hz;
+      }
+    }
+  }
+  lo[0] = lx;
+  lo[1] = ly;
+  lo[2] = lz;
+  hi[0] = hx;
+  hi[1] = hy;
+  hi[2] = hz;
+}
+
+// Narrows the lattice create_grid laid out over the whole box. A set that
+// mirrors keeps a span symmetric about the middle node, so
+// lattice_mirrors still finds the mirror. Nothing changes when fitting is
+// off or the coarse pass finds no node near the set.
+void fit_lattice(t_data *data) {
+  t_fract *f = data->fract;
+  uint h = f->fit;
+  uint mirrors;
+  float **grid[3] = {&f->grid.x, &f->grid.y, &f->grid.z};
+  uint *cells[3] = {&f->cells.x, &f->cells.y, &f->cells.z};
+  uint lo[3];
+  uint hi[3];
+  uint first;
+  uint last;
+  float *xs;
+  float *out;
+
+  if (!h)
+    return;
+  xs = (float *)malloc(coarse_nodes(f->cells.x, h) * sizeof(float));
+  out = (float *)malloc((size_t)coarse_nodes(f->cells.x, h) *
+                        coarse_nodes(f->cells.z, h) * sizeof(float));
+  if (!xs || !out)
+    error(MALLOC_FAIL_ERR, data);
+  coarse_span(f, h, lo, hi, xs, out);
+  free(xs);
+  free(out);
+  if (lo[0] > hi[0])
+    return;
+  mirrors = f->symmetry ? set_mirrors(f, lattice_sampler(f)) : 0;
+  for (int a = 0; a < 3; a++) {
+    first = lo[a] ? coarse_node(lo[a] - 1, h, *cells[a]) : 0;
+    last = coarse_node(hi[a] + 1, h, *cells[a]);
+    if (mirrors & (1u << a)) {
+      first = first < *cells[a] - last ? first : *cells[a] - last;
+      last = *cells[a] - first;
+    }
+    memmove(*grid[a], *grid[a] + first, (last - first + 1) * sizeof(float));
+    *cells[a] = last - first;
+  }
+  f->grid_size = (float)f->cells.x;
+}
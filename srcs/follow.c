@@ -0,0 +1,260 @@
+#include "morphosis.h"
+
+// Surface following: lines of nodes every few cells are sampled to find
+// cells the surface crosses, and from those the search spreads in waves to
+// neighbouring cells only across faces the surface crosses too. Nodes are
+// sampled when a wave first needs them, so the work grows with the surface
+// instead of the lattice. A piece of surface no seed line passes through is
+// not found.
+//
+// Crossed cells are meshed in lattice order with the usual edge cache, so
+// every piece that is found comes out exactly as a full scan would mesh it,
+// but on a single slab, single-threaded, whatever the thread count.
+
+static size_t node_of(t_fract *f, uint x, uint y, uint z) {
+  return ((size_t)z * (f->cells.y + 1) + y) * (f->cells.x + 1) + x;
+}
+
+static size_t cell_at(t_fract *f, uint x, uint y, uint z) {
+  return ((size_t)z * f->cells.y + y) * f->cells.x + x;
+}
+
+static uint3 cell_pos(t_fract *f, size_t i) {
+  uint3 cell;
+
+  cell.x = (uint)(i % f->cells.x);
+  cell.y = (uint)(i / f->cells.x % f->cells.y);
+  cell.z = (uint)(i / f->cells.x / f->cells.y);
+  return cell;
+}
+
+// Sets bit i, returning whether it was set already
+static int bit_mark(uchar *bits, size_t i) {
+  uchar mask = (uchar)(1u << (i & 7));
+  int seen = (bits[i >> 3] & mask) != 0;
+
+  bits[i >> 3] |= mask;
+  return seen;
+}
+
+static void indices_push(t_data *data, t_indices *list, size_t i) {
+  size_t *tmp;
+
+  if (list->len == list->cap) {
+    list->cap = list->cap ? list->cap * 2 : 1024;
+    if (!(tmp = (size_t *)realloc(list->at, list->cap * sizeof(size_t))))
+      error(MALLOC_FAIL_ERR, data);
+    list->at = tmp;
+  }
+  list->at[list->len++] = i;
+}
+
+static int indices_order(const void *a, const void *b) {
+  size_t i = *(const size_t *)a;
+  size_t j = *(const size_t *)b;
+
+  return (i > j) - (i < j);
+}
+
+static void reach_cell(t_data *data, t_follow *fl, int x, int y, int z) {
+  t_fract *f = data->fract;
+
+  if (x < 0 || y < 0 || z < 0 || x >= (int)f->cells.x ||
+      y >= (int)f->cells.y || z >= (int)f->cells.z)
+    return;
+  if (!bit_mark(fl->reached, cell_at(f, (uint)x, (uint)y, (uint)z)))
+    indices_push(data, &fl->next, cell_at(f, (uint)x, (uint)y, (uint)z));
+}
+
+// Samples whole node rows along x every spacing nodes in y and z. Each
+// change of side along a row crosses an x edge whose four cells seed the
+// search.
+static void seed_lines(t_data *data, t_sampler sampler, t_follow *fl) {
+  t_fract *f = data->fract;
+  uint s = f->follow;
+  uint ny = f->cells.y / s + 1;
+  uint nz = f->cells.z / s + 1;
+  float *val;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f))
+#endif
+  for (uint k = 0; k < ny * nz; k++) {
+    double start = stats_clock(f);
+
+    sampler(f->julia, f->grid.x, f->grid.y[k % ny * s], f->grid.z[k / ny * s],
+            f->cells.x + 1,
+            data->vertexval + node_of(f, 0, k % ny * s, k / ny * s));
+    stats_add(f, STAGE_SAMPLE, start);
+    stats_evals(f, f->cells.x + 1);
+  }
+  for (uint z = 0; z <= f->cells.z; z += s) {
+    for (uint y = 0; y <= f->cells.y; y += s) {
+      val = data->vertexval + node_of(f, 0, y, z);
+      for (uint x = 0; x <= f->cells.x; x++)
+        bit_mark(fl->sampled, node_of(f, x, y, z));
+      for (uint x = 0; x < f->cells.x; x++) {
+        if ((val[x] > 0.0f) == (val[x + 1] > 0.0f))
+          continue;
+        for (int c = 0; c < 4; c++)
+          reach_cell(data, fl, (int)x, (int)y - (c & 1), (int)z - (c >> 1));
+      }
+    }
+  }
+}
+
+// Samples the corners of this wave's cells not sampled yet, sorted so each
+// row of nodes goes to the row sampler in one call
+static void sample_wave(t_data *data, t_sampler sampler, t_follow *fl) {
+  t_fract *f = data->fract;
+  size_t row = f->cells.x + 1;
+  t_indices runs = {NULL, 0, 0};
+  float *xs;
+  float *out;
+  uint3 cell;
+  size_t n;
+
+  fl->nodes.len = 0;
+  for (size_t i = 0; i < fl->wave.len; i++) {
+    cell = cell_pos(f, fl->wave.at[i]);
+    for (int c = 0; c < 8; c++) {
+      n = node_of(f, cell.x + f->voxel[c].dx, cell.y + f->voxel[c].dy,
+                  cell.z + f->voxel[c].dz);
+      if (!bit_mark(fl->sampled, n))
+        indices_push(data, &fl->nodes, n);
+    }
+  }
+  if (!fl->nodes.len)
+    return;
+  qsort(fl->nodes.at, fl->nodes.len, sizeof(size_t), indices_order);
+  for (size_t i = 0; i < fl->nodes.len; i++)
+    if (!i || fl->nodes.at[i] / row != fl->nodes.at[i - 1] / row)
+      indices_push(data, &runs, i);
+  indices_push(data, &runs, fl->nodes.len);
+  xs = (float *)malloc(fl->nodes.len * sizeof(float));
+  out = (float *)malloc(fl->nodes.len * sizeof(float));
+  if (!xs || !out)
+    error(MALLOC_FAIL_ERR, data);
+  for (size_t i = 0; i < fl->nodes.len; i++)
+    xs[i] = f->grid.x[fl->nodes.at[i] % row];
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f))
+#endif
+  for (size_t r = 0; r < runs.len - 1; r++) {
+    size_t a = runs.at[r];
+    size_t y = fl->nodes.at[a] / row % (f->cells.y + 1);
+    size_t z = fl->nodes.at[a] / row / (f->cells.y + 1);
+    double start = stats_clock(f);
+
+    sampler(f->julia, xs + a, f->grid.y[y], f->grid.z[z],
+            (uint)(runs.at[r + 1] - a), out + a);
+    stats_add(f, STAGE_SAMPLE, start);
+    stats_evals(f, runs.at[r + 1] - a);
+  }
+  for (size_t i = 0; i < fl->nodes.len; i++)
+    data->vertexval[fl->nodes.at[i]] = out[i];
+  free(xs);
+  free(out);
+  free(runs.at);
+}
+
+static uint cell_cube(t_fract *f, const float *val, uint3 cell) {
+  const float *base = val + node_of(f, cell.x, cell.y, cell.z);
+  size_t plane = lattice_plane(f);
+  uint cube = 0;
+
+  for (int c = 0; c < 8; c++)
+    if (base[f->voxel[c].dz * plane + f->voxel[c].offset] > 0.0f)
+      cube |= 1u << c;
+  return cube;
+}
+
+// Keeps the crossed cells of this wave, their cube index in the low byte,
+// and reaches across their crossed faces for the next one
+static void classify_wave(t_data *data, t_follow *fl) {
+  t_fract *f = data->fract;
+  uint3 cell;
+  uint cube;
+  uint faces;
+  int d;
+
+  for (size_t i = 0; i < fl->wave.len; i++) {
+    cell = cell_pos(f, fl->wave.at[i]);
+    cube = cell_cube(f, data->vertexval, cell);
+    if (!(faces = cube_faces(cube)))
+      continue;
+    indices_push(data, &fl->surface, fl->wave.at[i] << 8 | cube);
+    for (uint k = 0; k < 6; k++) {
+      if (!(faces & (1u << k)))
+        continue;
+      d = k & 1 ? 1 : -1;
+      reach_cell(data, fl, (int)cell.x + (k / 2 == 0 ? d : 0),
+                 (int)cell.y + (k / 2 == 1 ? d : 0),
+                 (int)cell.z + (k / 2 == 2 ? d : 0));
+    }
+  }
+}
+
+// Meshes the crossed cells in lattice order, which sorting them gives, on
+// one slab and one thread, rolling the edge cache as the layer changes
+static void mesh_surface(t_data *data, t_follow *fl) {
+  t_fract *f = data->fract;
+  t_slab *slab;
+  double start;
+  uint3 cell;
+  uint z;
+
+  if (!(slab = slab_split(data, 1)))
+    error(MALLOC_FAIL_ERR, data);
+  qsort(fl->surface.at, fl->surface.len, sizeof(size_t), indices_order);
+  z = 0;
+  start = stats_clock(f);
+  for (size_t i = 0; i < fl->surface.len; i++) {
+    cell = cell_pos(f, fl->surface.at[i] >> 8);
+    for (uint k = z; k < cell.z && k < z + 2; k++)
+      edge_cache_roll(&slab->edges, 1);
+    z = cell.z;
+    slab->planes[0] = data->vertexval + z * lattice_plane(f);
+    slab->planes[1] = slab->planes[0] + lattice_plane(f);
+    if (!mesh_reserve(slab->mesh, MC_MAX_VERTS, MC_MAX_TRIS))
+      error(MALLOC_FAIL_ERR, data);
+    polygonise(f, slab, cell, fl->surface.at[i] & 0xff);
+  }
+  start = stats_add(f, STAGE_EMIT, start);
+  if (f->refine) {
+    refine_vertices(f->julia, slab->mesh, f->refine);
+    stats_add(f, STAGE_SAMPLE, start);
+    stats_evals(f, (size_t)slab->mesh->num_verts * f->refine);
+  }
+  slab_free(slab, 1);
+}
+
+void follow_surface(t_data *data, t_sampler sampler) {
+  t_fract *f = data->fract;
+  t_follow fl;
+  t_indices tmp;
+  size_t cells = (size_t)f->cells.x * f->cells.y * f->cells.z;
+
+  memset(&fl, 0, sizeof(t_follow));
+  fl.sampled = (uchar *)calloc(lattice_nodes(f) / 8 + 1, 1);
+  fl.reached = (uchar *)calloc(cells / 8 + 1, 1);
+  if (!fl.sampled || !fl.reached)
+    error(MALLOC_FAIL_ERR, data);
+  seed_lines(data, sampler, &fl);
+  while (fl.next.len && !generation_cancelled(f)) {
+    tmp = fl.wave;
+    fl.wave = fl.next;
+    fl.next = tmp;
+    fl.next.len = 0;
+    sample_wave(data, sampler, &fl);
+    classify_wave(data, &fl);
+  }
+  if (!generation_cancelled(f))
+    mesh_surface(data, &fl);
+  free(fl.sampled);
+  free(fl.reached);
+  free(fl.wave.at);
+  free(fl.next.at);
+  free(fl.nodes.at);
+  free(fl.surface.at);
+}
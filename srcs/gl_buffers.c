@@ -12,3 +12,75 @@ void						createVAO(t_gl *gl)
 	glGenVertexArrays(1, &gl->vao);
 	glBindVertexArray(gl->vao);
 }
+
+/*
+** The element buffer is recorded in the bound VAO, so createVAO must come
+** first.
+*/
+
+void						createEBO(t_gl *gl, GLsizeiptr size, GLuint *indices)
+{
+	glGenBuffers(1, &gl->ebo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_DYNAMIC_DRAW);
+}
+
+/*
+** Double buffering: a mesh built in the background goes into the back
+** buffers, which then trade places with the ones being drawn from, so the
+** upload never touches a buffer a frame in flight still reads. The VAO
+** records the element buffer and the buffer of each attribute, so both are
+** pointed at the new ones.
+*/
+
+void						gl_swap_mesh(t_data *data)
+{
+	t_gl					*gl;
+	GLuint					tmp;
+	double					start;
+
+	gl = data->gl;
+	if (!gl->vbo)
+		return ;
+	start = stats_clock(data->fract);
+	if (!gl->back_vbo)
+		glGenBuffers(1, &gl->back_vbo);
+	if (!gl->back_ebo)
+		glGenBuffers(1, &gl->back_ebo);
+	glBindVertexArray(gl->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->back_vbo);
+	glBufferData(GL_ARRAY_BUFFER, gl->num_pts * sizeof(float),
+		(GLfloat *)gl->tris, GL_DYNAMIC_DRAW);
+	gl_set_attrib_ptr(gl, "pos", 3, 3, 0);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->back_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		(size_t)gl->num_tris * 3 * sizeof(GLuint), data->mesh.idx,
+		GL_DYNAMIC_DRAW);
+	tmp = gl->vbo;
+	gl->vbo = gl->back_vbo;
+	gl->back_vbo = tmp;
+	tmp = gl->ebo;
+	gl->ebo = gl->back_ebo;
+	gl->back_ebo = tmp;
+	stats_add(data->fract, STAGE_UPLOAD, start);
+}
+
+void						gl_upload_mesh(t_data *data)
+{
+	t_gl					*gl;
+	double					start;
+
+	gl = data->gl;
+	if (!gl->vbo)
+		return ;
+	start = stats_clock(data->fract);
+	glBindVertexArray(gl->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, gl->vbo);
+	glBufferData(GL_ARRAY_BUFFER, gl->num_pts * sizeof(float),
+		(GLfloat *)gl->tris, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gl->ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+		(size_t)gl->num_tris * 3 * sizeof(GLuint), data->mesh.idx,
+		GL_DYNAMIC_DRAW);
+	stats_add(data->fract, STAGE_UPLOAD, start);
+}
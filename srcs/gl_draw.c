@@ -1,11 +1,20 @@
 #include "morphosis.h"
 
 void run_graphics(t_gl *gl, float3 max, float3 min) {
+  double start;
+
   gl_scale_tris(gl, max, min);
+  mesh_cache_store(&gl->data->cache, gl->data->fract, gl->data);
 
   init_gl(gl);
+  gl_prof_init(gl);
   createVAO(gl);
+  start = stats_clock(gl->data->fract);
   createVBO(gl, gl->num_pts * sizeof(float), (GLfloat *)gl->tris);
+  createEBO(gl, (size_t)gl->num_tris * 3 * sizeof(GLuint),
+            gl->data->mesh.idx);
+  stats_add(gl->data->fract, STAGE_UPLOAD, start);
+  gl->data->stats.builds++;
 
   makeShaderProgram(gl);
   gl_set_attrib_ptr(gl, "pos", 3, 3, 0);
@@ -17,8 +26,13 @@ void run_graphics(t_gl *gl, float3 max, float3 min) {
   // Initialize GUI
   gui_init_c(gl->window);
 
+  // Rebuilds run on a worker thread while the current mesh is drawn
+  regen_start(gl->data);
+
   gl_render(gl);
 
+  regen_stop(gl->data);
+
   // Cleanup GUI
   gui_shutdown_c();
 
@@ -27,12 +41,12 @@ void run_graphics(t_gl *gl, float3 max, float3 min) {
 
 void gl_render(t_gl *gl) {
   while (!glfwWindowShouldClose(gl->window)) {
+    gl_prof_frame_begin(gl);
     processInput(gl->window, gl);
 
-    // Check if fractal needs regeneration
-    if (gl->data && gl->data->needs_regeneration) {
-      regenerate_fractal_fast(gl->data);
-    }
+    // Hand parameter changes to the background build, show finished ones
+    if (gl->data)
+      regenerate_fractal_async(gl->data);
 
     // Start the Dear ImGui frame
     gui_new_frame_c();
@@ -57,13 +71,18 @@ void gl_render(t_gl *gl) {
     }
 
     // Render the 3D fractal
-    glDrawArrays(GL_TRIANGLES, 0, gl->num_pts);
+    gl_prof_begin(gl, PASS_FRACTAL);
+    glDrawElements(GL_TRIANGLES, gl->num_tris * 3, GL_UNSIGNED_INT, 0);
+    gl_prof_end(gl);
 
     // Render GUI on top
     if (gl->data) {
       gui_render_all_c(gl->data);
     }
+    gl_prof_begin(gl, PASS_GUI);
     gui_render_c();
+    gl_prof_end(gl);
+    gl_prof_frame_end(gl, (uint)gl->num_tris * 3, (uint)gui_vertices_c());
 
     glfwSwapBuffers(gl->window);
     glfwPollEvents();
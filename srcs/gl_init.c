@@ -37,8 +37,12 @@ t_gl *init_gl_struct(void) {
   gl->fragmentShader = 0;
   gl->vbo = 0;
   gl->vao = 0;
+  gl->ebo = 0;
+  gl->back_vbo = 0;
+  gl->back_ebo = 0;
   gl->tris = NULL;
   gl->num_pts = 0;
+  gl->num_tris = 0;
   gl->matrix = initGlMatrices();
 
   // Initialize rendering state
@@ -51,6 +55,7 @@ t_gl *init_gl_struct(void) {
   gl->line_color[2] = 1.0f;
   gl->auto_rotate = 0;
   gl->rotation_speed = 1.0f;
+  memset(&gl->prof, 0, sizeof(t_frame_prof));
 
   return gl;
 }
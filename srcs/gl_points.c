@@ -1,26 +1,33 @@
 #include "morphosis.h"
 
-void						gl_retrieve_tris(t_data *data)
+/*
+** Copies the mesh's vertices out for drawing. Returns 0 if they cannot be
+** allocated: the regeneration worker calls it too, and must not exit.
+*/
+
+int							gl_retrieve_tris(t_data *data)
 {
-	uint					i;
+	float3					*v;
+	size_t					n;
 	uint 					j;
+	double					start;
 
-	i = 0;
 	j = 0;
+	start = stats_clock(data->fract);
+	free(data->gl->tris);
 	if (!(data->gl->tris = (float *)malloc(data->gl->num_pts * sizeof(float))))
-		error(MALLOC_FAIL_ERR, data);
+		return (0);
 
-	bzero(data->gl->tris, data->gl->num_pts);
-	while (j < data->gl->num_pts)
+	v = data->mesh.verts;
+	n = data->mesh.num_verts;
+	for (size_t i = 0; i < n; i++)
 	{
-		for (int c = 0; c < 3; c++)
-		{
-			data->gl->tris[j++] = data->triangles[i][c].x;
-			data->gl->tris[j++] = data->triangles[i][c].y;
-			data->gl->tris[j++] = data->triangles[i][c].z;
-		}
-		i++;
+		data->gl->tris[j++] = v[i].x;
+		data->gl->tris[j++] = v[i].y;
+		data->gl->tris[j++] = v[i].z;
 	}
+	stats_add(data->fract, STAGE_RETRIEVE, start);
+	return (1);
 }
 
 void						gl_set_attrib_ptr(t_gl *gl, char *attrib_name, GLint num_vals, int stride, int offset)
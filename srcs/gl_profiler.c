@@ -0,0 +1,124 @@
+#include "morphosis.h"
+
+// Frame profiler: each frame wraps the fractal draw and the GUI pass in a
+// GL_TIME_ELAPSED query of its own slot in a ring of FRAME_QUERIES frames.
+// A slot's results are read back just before it is reused, by which time
+// the GPU has long finished them on any driver, llvmpipe included; one
+// still pending is dropped rather than waited for, so reading never
+// stalls the pipeline, and its frame logged without GPU times. Without
+// timer queries (before GL 3.3 and ARB_timer_query) only the CPU side is
+// measured.
+
+void gl_prof_init(t_gl *gl) {
+  t_frame_prof *p = &gl->prof;
+
+  p->timer_queries = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+  if (p->timer_queries)
+    glGenQueries(FRAME_QUERIES * PASS_COUNT, &p->queries[0][0]);
+}
+
+static void prof_write(t_frame_prof *p, unsigned long frame, int slot,
+                       int gpu) {
+  if (!p->csv)
+    return;
+  fprintf(p->csv, "%lu,%.4f,", frame, p->cpu_ms[slot]);
+  if (gpu)
+    fprintf(p->csv, "%.4f,%.4f,", p->gpu_ms[PASS_FRACTAL],
+            p->gpu_ms[PASS_GUI]);
+  else
+    fprintf(p->csv, ",,");
+  fprintf(p->csv, "%u,%u\n", p->indices[slot], p->gui_verts[slot]);
+}
+
+// Starts logging to path, or stops with NULL. Returns 0 if path cannot be
+// opened.
+int gl_prof_log(t_gl *gl, const char *path) {
+  t_frame_prof *p = &gl->prof;
+
+  if (p->csv)
+    fclose(p->csv);
+  p->csv = NULL;
+  if (!path)
+    return 1;
+  if (!(p->csv = fopen(path, "w")))
+    return 0;
+  fprintf(p->csv, "frame,cpu_ms,gpu_fractal_ms,gpu_gui_ms,fractal_indices,"
+                  "gui_vertices\n");
+  return 1;
+}
+
+// Reads back the results of frame, whose slot is about to be reused, and
+// logs it with them if they are in or without them if not
+static void prof_collect(t_frame_prof *p, unsigned long frame) {
+  int slot = (int)(frame % FRAME_QUERIES);
+  GLint available;
+  GLuint64 ns;
+
+  if (!p->issued[slot])
+    return;
+  p->issued[slot] = 0;
+  glGetQueryObjectiv(p->queries[slot][PASS_COUNT - 1],
+                     GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available) {
+    p->dropped++;
+    prof_write(p, frame, slot, 0);
+    return;
+  }
+  for (int k = 0; k < PASS_COUNT; k++) {
+    glGetQueryObjectui64v(p->queries[slot][k], GL_QUERY_RESULT, &ns);
+    p->gpu_ms[k] = (double)ns * 1e-6;
+  }
+  p->gpu_frame = frame;
+  prof_write(p, frame, slot, 1);
+}
+
+void gl_prof_frame_begin(t_gl *gl) {
+  t_frame_prof *p = &gl->prof;
+
+  p->start = glfwGetTime();
+  if (p->timer_queries && p->frame >= FRAME_QUERIES)
+    prof_collect(p, p->frame - FRAME_QUERIES);
+}
+
+void gl_prof_begin(t_gl *gl, t_pass pass) {
+  t_frame_prof *p = &gl->prof;
+
+  if (p->timer_queries)
+    glBeginQuery(GL_TIME_ELAPSED,
+                 p->queries[p->frame % FRAME_QUERIES][pass]);
+}
+
+void gl_prof_end(t_gl *gl) {
+  if (gl->prof.timer_queries)
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+// Called before the buffers are swapped, so waiting for vsync is not
+// counted as CPU time
+void gl_prof_frame_end(t_gl *gl, uint indices, uint gui_vertices) {
+  t_frame_prof *p = &gl->prof;
+  int slot = (int)(p->frame % FRAME_QUERIES);
+
+  p->cpu_ms[slot] = p->last_cpu_ms = (glfwGetTime() - p->start) * 1e3;
+  p->indices[slot] = p->last_indices = indices;
+  p->gui_verts[slot] = p->last_gui_verts = gui_vertices;
+  if (p->timer_queries)
+    p->issued[slot] = 1;
+  else
+    prof_write(p, p->frame, slot, 0);
+  p->frame++;
+}
+
+// Logs the frames still in the ring before closing the log
+void gl_prof_free(t_gl *gl) {
+  t_frame_prof *p = &gl->prof;
+
+  if (p->timer_queries) {
+    for (unsigned long k = p->frame < FRAME_QUERIES ? 0
+                                                    : p->frame - FRAME_QUERIES;
+         k < p->frame; k++)
+      prof_collect(p, k);
+    glDeleteQueries(FRAME_QUERIES * PASS_COUNT, &p->queries[0][0]);
+  }
+  gl_prof_log(gl, NULL);
+}
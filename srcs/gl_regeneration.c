@@ -5,18 +5,8 @@ void regenerate_fractal(t_data *data) {
   if (!data->needs_regeneration)
     return;
 
-  printf("Regenerating fractal with %d iterations...\n",
-         data->fract->julia->max_iter);
-
-  // Clean up old triangle data
-  if (data->triangles) {
-    clean_trigs(data->triangles, data->len.x);
-    data->triangles = NULL;
-  }
-
-  // Reset counters
-  data->len.x = 0;
-  data->len.y = 0;
+  // Drop old triangles but keep the buffer for the new mesh
+  mesh_clear(&data->mesh);
 
   // Use optimized fractal generation if available
 #ifdef OPTIMIZED
@@ -25,21 +15,18 @@ void regenerate_fractal(t_data *data) {
   build_fractal(data);
 #endif
 
-  // Update GL data
-  gl_retrieve_tris(data);
+  // Update GL data, at the scale run_graphics first showed
+  if (!gl_retrieve_tris(data))
+    error(MALLOC_FAIL_ERR, data);
+  gl_scale_tris(data->gl, data->fract->p1, data->fract->p0);
 
-  // Update VBO with new triangle data
-  if (data->gl->vbo) {
-    glBindBuffer(GL_ARRAY_BUFFER, data->gl->vbo);
-    glBufferData(GL_ARRAY_BUFFER, data->gl->num_pts * sizeof(float),
-                 (GLfloat *)data->gl->tris, GL_DYNAMIC_DRAW);
-  }
+  // Update vertex and index buffers with the new mesh
+  gl_upload_mesh(data);
 
   // Clean up calculation data
   clean_calcs(data);
 
   data->needs_regeneration = 0;
-  printf("Fractal regenerated! %d triangles generated.\n", data->gl->num_tris);
 }
 
 // Safe fractal regeneration using existing functions
@@ -47,35 +34,305 @@ void regenerate_fractal_fast(t_data *data) {
   if (!data->needs_regeneration)
     return;
 
-  printf("Fast regenerating fractal with %d iterations...\n",
-         data->fract->julia->max_iter);
-
-  // Clean up old triangle data first
-  if (data->triangles) {
-    clean_trigs(data->triangles, data->len.x);
-    data->triangles = NULL;
-  }
-
-  // Reset counters
-  data->len.x = 0;
-  data->len.y = 0;
+  // Drop old triangles but keep the buffer for the new mesh
+  mesh_clear(&data->mesh);
 
   // Use the existing, safe fractal generation functions
 #ifdef OPTIMIZED
   calculate_point_cloud_optimized(data);
 #else
   calculate_point_cloud(data);
-  gl_retrieve_tris(data);
+#endif
+  if (!gl_retrieve_tris(data))
+    error(MALLOC_FAIL_ERR, data);
   clean_calcs(data);
+  // Same scale as the mesh run_graphics first showed, and as build_back's,
+  // which the mesh cache keeps alongside these
+  gl_scale_tris(data->gl, data->fract->p1, data->fract->p0);
+
+  // Update vertex and index buffers with the new mesh
+  gl_upload_mesh(data);
+
+  data->needs_regeneration = 0;
+}
+
+// Background regeneration: requests from the GL thread go to a worker that
+// builds into its own t_data, so the window keeps drawing the current mesh
+// meanwhile. A newer request cancels the build in progress, which stops at
+// its next plane or layer, so a slider dragged through many values costs
+// one build at the end rather than one per value. Previews, requested while
+// a slider is held, are the exception: a preview in progress finishes, so
+// one keeps showing up every so often during a long drag. The GL thread
+// picks up a finished build between frames and swaps it into the vertex
+// buffers.
+
+// Step of a preview expected to take PREVIEW_BUDGET seconds, judging by the
+// last build shown: generation time grows with the node count, as the cube
+// of 1 / step. Steps go up in quarter octaves, so successive previews share
+// a lattice and with it the orbit cache. With no build timed yet the step
+// is doubled.
+static float preview_step(t_data *data) {
+  t_fract *f = data->fract;
+  float coarsest = (f->p1.x - f->p0.x) / PREVIEW_MIN_CELLS;
+  float scale;
+
+  if (data->build_seconds <= 0.0 || data->build_step <= 0.0f)
+    scale = 2.0f;
+  else
+    scale = data->build_step / f->step_size *
+            cbrtf((float)(data->build_seconds / PREVIEW_BUDGET));
+  if (scale <= 1.0f || coarsest <= f->step_size)
+    return f->step_size;
+  scale = exp2f(ceilf(4.0f * log2f(scale)) / 4.0f);
+  return f->step_size * scale < coarsest ? f->step_size * scale : coarsest;
+}
+
+// Takes the latest parameters, keeping the worker's own julia, grid, brick
+// verdicts and cancel flag. The build is profiled if the request was.
+static void take_request(t_regen *r) {
+  t_fract *f = r->back->fract;
+  t_julia *julia = f->julia;
+  t_grid grid = f->grid;
+  t_bricks culled = f->culled;
+
+  *f = r->want;
+  *julia = r->julia;
+  f->julia = julia;
+  f->grid = grid;
+  f->culled = culled;
+  f->cancel = &r->cancel;
+  f->stats = f->stats ? &r->back->stats : NULL;
+}
+
+// Returns 0 for no mesh to show: the build was cancelled, or its vertices
+// could not be copied out, which the worker must not exit over
+static int build_back(t_data *back) {
+  int built;
+
+#ifdef OPTIMIZED
+  calculate_point_cloud_optimized(back);
+#else
+  calculate_point_cloud(back);
 #endif
+  built = !generation_cancelled(back->fract) && gl_retrieve_tris(back);
+  clean_calcs(back);
+  // Same scale as the mesh run_graphics first showed
+  if (built)
+    gl_scale_tris(back->gl, back->fract->p1, back->fract->p0);
+  return built;
+}
+
+// Builds the latest request, over and over. A finished preview waits to be
+// shown before the next build overwrites it; a full build a newer request
+// superseded is simply dropped.
+static void *regen_worker(void *arg) {
+  t_regen *r = (t_regen *)arg;
+  double start;
+  int built;
 
-  // Update VBO with new triangle data
-  if (data->gl->vbo) {
-    glBindBuffer(GL_ARRAY_BUFFER, data->gl->vbo);
-    glBufferData(GL_ARRAY_BUFFER, data->gl->num_pts * sizeof(float),
-                 (GLfloat *)data->gl->tris, GL_DYNAMIC_DRAW);
+  pthread_mutex_lock(&r->lock);
+  while (1) {
+    while (!r->quit && (!r->pending || (r->ready && r->preview)))
+      pthread_cond_wait(&r->wake, &r->lock);
+    if (r->quit)
+      break;
+    take_request(r);
+    r->pending = 0;
+    r->ready = 0;
+    r->busy = 1;
+    r->preview = r->want_preview;
+    __atomic_store_n(&r->cancel, 0, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&r->lock);
+    start = glfwGetTime();
+    built = build_back(r->back);
+    pthread_mutex_lock(&r->lock);
+    r->seconds = glfwGetTime() - start;
+    r->busy = 0;
+    r->ready = built && !r->cancel;
   }
+  pthread_mutex_unlock(&r->lock);
+  return NULL;
+}
+
+// Starts the worker, which takes over the orbit cache of the first build;
+// without a worker data->regen stays NULL and regeneration runs inline
+void regen_start(t_data *data) {
+  t_regen *r;
 
+  if (!data || !(r = (t_regen *)calloc(1, sizeof(t_regen))))
+    return;
+  r->back = init_data();
+  r->back->gl->data = r->back;
+  if (pthread_mutex_init(&r->lock, NULL)) {
+    clean_up(r->back);
+    free(r);
+    return;
+  }
+  if (pthread_cond_init(&r->wake, NULL)) {
+    pthread_mutex_destroy(&r->lock);
+    clean_up(r->back);
+    free(r);
+    return;
+  }
+  if (pthread_create(&r->thread, NULL, regen_worker, r)) {
+    pthread_cond_destroy(&r->wake);
+    pthread_mutex_destroy(&r->lock);
+    clean_up(r->back);
+    free(r);
+    return;
+  }
+  r->back->orbit = data->orbit;
+  orbit_init(&data->orbit);
+  data->regen = r;
+}
+
+// Cancels any build in progress and waits for the worker to finish
+void regen_stop(t_data *data) {
+  t_regen *r = data ? data->regen : NULL;
+
+  if (!r)
+    return;
+  pthread_mutex_lock(&r->lock);
+  r->quit = 1;
+  __atomic_store_n(&r->cancel, 1, __ATOMIC_RELAXED);
+  pthread_cond_signal(&r->wake);
+  pthread_mutex_unlock(&r->lock);
+  pthread_join(r->thread, NULL);
+  pthread_cond_destroy(&r->wake);
+  pthread_mutex_destroy(&r->lock);
+  clean_up(r->back);
+  free(r);
+  data->regen = NULL;
+}
+
+int regen_busy(t_data *data) {
+  t_regen *r = data->regen;
+  int busy;
+
+  if (!r)
+    return 0;
+  pthread_mutex_lock(&r->lock);
+  busy = r->busy || r->pending;
+  pthread_mutex_unlock(&r->lock);
+  return busy;
+}
+
+// Shows a finished build: its mesh, vertices and lattice axes trade places
+// with the ones on screen, whose memory the worker then reuses
+static void regen_collect(t_data *data) {
+  t_regen *r = data->regen;
+  t_data *back = r->back;
+  t_fract built;
+  t_julia julia;
+  unsigned long builds;
+  int preview;
+  t_mesh mesh;
+  t_grid grid;
+  float *tris;
+  uint n;
+
+  pthread_mutex_lock(&r->lock);
+  if (!r->ready) {
+    pthread_mutex_unlock(&r->lock);
+    return;
+  }
+  mesh = data->mesh;
+  data->mesh = back->mesh;
+  back->mesh = mesh;
+  tris = data->gl->tris;
+  data->gl->tris = back->gl->tris;
+  back->gl->tris = tris;
+  n = data->gl->num_pts;
+  data->gl->num_pts = back->gl->num_pts;
+  back->gl->num_pts = n;
+  n = data->gl->num_tris;
+  data->gl->num_tris = back->gl->num_tris;
+  back->gl->num_tris = n;
+  grid = data->fract->grid;
+  data->fract->grid = back->fract->grid;
+  back->fract->grid = grid;
+  data->fract->cells = back->fract->cells;
+  data->fract->grid_size = back->fract->grid_size;
+  data->build_seconds = r->seconds;
+  data->build_step = back->fract->step_size;
+  builds = data->stats.builds;
+  data->stats = back->stats;
+  data->stats.builds = builds + 1;
+  built = *back->fract;
+  julia = *back->fract->julia;
+  built.julia = &julia;
+  preview = r->preview;
+  r->ready = 0;
+  pthread_cond_signal(&r->wake);
+  pthread_mutex_unlock(&r->lock);
+  gl_swap_mesh(data);
+  if (!preview)
+    mesh_cache_store(&data->cache, &built, data);
+}
+
+// A mesh cached for the requested parameters is shown at once, whatever the
+// worker was doing: its build in progress or waiting to be shown is stale
+static int regen_from_cache(t_data *data) {
+  t_regen *r = data->regen;
+
+  if (!mesh_cache_fetch(&data->cache, data->fract, data))
+    return 0;
+  if (r) {
+    pthread_mutex_lock(&r->lock);
+    r->pending = 0;
+    r->ready = 0;
+    __atomic_store_n(&r->cancel, 1, __ATOMIC_RELAXED);
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+    gl_swap_mesh(data);
+  } else
+    gl_upload_mesh(data);
   data->needs_regeneration = 0;
-  printf("Fast regeneration complete! Generated %d triangles\n", data->gl->num_tris);
+  return 1;
+}
+
+// Inline regeneration, timed for preview_step
+static void regenerate_inline(t_data *data) {
+  t_fract *f = data->fract;
+  float step = f->step_size;
+  double start;
+
+  if (!data->needs_regeneration || regen_from_cache(data))
+    return;
+  if (data->preview)
+    f->step_size = preview_step(data);
+  start = glfwGetTime();
+  regenerate_fractal_fast(data);
+  data->build_seconds = glfwGetTime() - start;
+  data->build_step = f->step_size;
+  data->stats.builds++;
+  f->step_size = step;
+  if (!data->preview)
+    mesh_cache_store(&data->cache, f, data);
+}
+
+// Called once a frame: hands a change of parameters to the worker, or
+// regenerates inline without one, and shows whatever the worker finished
+void regenerate_fractal_async(t_data *data) {
+  t_regen *r = data->regen;
+
+  if (!r) {
+    regenerate_inline(data);
+    return;
+  }
+  if (data->needs_regeneration && !regen_from_cache(data)) {
+    pthread_mutex_lock(&r->lock);
+    r->want = *data->fract;
+    r->julia = *data->fract->julia;
+    if (data->preview)
+      r->want.step_size = preview_step(data);
+    if (!(data->preview && r->busy && r->preview))
+      __atomic_store_n(&r->cancel, 1, __ATOMIC_RELAXED);
+    r->want_preview = data->preview;
+    r->pending = 1;
+    pthread_cond_signal(&r->wake);
+    pthread_mutex_unlock(&r->lock);
+    data->needs_regeneration = 0;
+  }
+  regen_collect(data);
 }
@@ -71,6 +71,10 @@ void init_gl(t_gl *gl) {
 void terminate_gl(t_gl *gl) {
   glDeleteVertexArrays(1, &gl->vao);
   glDeleteBuffers(1, &gl->vbo);
+  glDeleteBuffers(1, &gl->ebo);
+  glDeleteBuffers(1, &gl->back_vbo);
+  glDeleteBuffers(1, &gl->back_ebo);
   glDeleteProgram(gl->shaderProgram);
+  gl_prof_free(gl);
   glfwTerminate();
 }
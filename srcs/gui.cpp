@@ -122,6 +122,17 @@ void gui_render_main_menu(t_data *data, t_gui_state *gui_state) {
   }
 }
 
+// While a slider is held its changes regenerate as a coarse preview; letting
+// go of it regenerates at the full resolution
+static void gui_apply_slider_changes(t_data *data, t_gui_state *gui_state,
+                                     bool changed) {
+  if (changed && ImGui::IsItemActive()) {
+    gui_apply_fractal_changes(data, gui_state);
+    data->preview = 1;
+  } else if (changed || ImGui::IsItemDeactivatedAfterEdit())
+    gui_apply_fractal_changes(data, gui_state);
+}
+
 void gui_render_fractal_controls(t_data *data, t_gui_state *gui_state) {
   if (!gui_state->show_fractal_controls)
     return;
@@ -132,11 +143,9 @@ void gui_render_fractal_controls(t_data *data, t_gui_state *gui_state) {
 
     // Iteration control
     int old_iterations = gui_state->max_iterations;
-    if (ImGui::SliderInt("Iterations", &gui_state->max_iterations, 1, 20)) {
-      if (gui_state->max_iterations != old_iterations) {
-        gui_apply_fractal_changes(data, gui_state);
-      }
-    }
+    ImGui::SliderInt("Iterations", &gui_state->max_iterations, 1, 20);
+    gui_apply_slider_changes(data, gui_state,
+                             gui_state->max_iterations != old_iterations);
 
     ImGui::Text("Current: %d iterations", gui_state->max_iterations);
 
@@ -144,19 +153,14 @@ void gui_render_fractal_controls(t_data *data, t_gui_state *gui_state) {
     ImGui::Text("Quaternion Parameters (c = a + bi + cj + dk)");
 
     // Quaternion parameters
-    bool params_changed = false;
-    params_changed |= ImGui::SliderFloat("a (real)", &gui_state->julia_c[0],
-                                         -2.0f, 2.0f, "%.3f");
-    params_changed |= ImGui::SliderFloat("b (i)", &gui_state->julia_c[1], -2.0f,
-                                         2.0f, "%.3f");
-    params_changed |= ImGui::SliderFloat("c (j)", &gui_state->julia_c[2], -2.0f,
-                                         2.0f, "%.3f");
-    params_changed |= ImGui::SliderFloat("d (k)", &gui_state->julia_c[3], -2.0f,
-                                         2.0f, "%.3f");
-
-    if (params_changed) {
-      gui_apply_fractal_changes(data, gui_state);
+    static const char *c_labels[4] = {"a (real)", "b (i)", "c (j)", "d (k)"};
+    for (int i = 0; i < 4; i++) {
+      bool changed = ImGui::SliderFloat(c_labels[i], &gui_state->julia_c[i],
+                                        -2.0f, 2.0f, "%.3f");
+      gui_apply_slider_changes(data, gui_state, changed);
     }
+    if (data->preview)
+      ImGui::Text("Previewing at step %.4f", data->build_step);
 
     ImGui::Separator();
 
@@ -172,6 +176,69 @@ void gui_render_fractal_controls(t_data *data, t_gui_state *gui_state) {
       }
     }
 
+    // Lattice narrowed to the set found by sampling every this many nodes
+    int fit = (int)data->fract->fit;
+    if (ImGui::SliderInt("Auto-Fit Bounds Stride", &fit, 0, 16)) {
+      data->fract->fit = (uint)fit;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Sets mirrored in an axis are meshed on one side and reflected
+    bool symmetry = data->fract->symmetry;
+    if (ImGui::Checkbox("Use Symmetry", &symmetry)) {
+      data->fract->symmetry = symmetry;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Binary samples kept one bit per node, classified a word at a time
+    bool packed = data->fract->packed;
+    if (ImGui::Checkbox("Packed Occupancy", &packed)) {
+      data->fract->packed = packed;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Cells meshed brick by brick in Morton order, for coherent output
+    int morton = (int)data->fract->morton;
+    if (ImGui::SliderInt("Morton Brick Size", &morton, 0, 32)) {
+      data->fract->morton = (uint)morton;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Distance sampling places vertices between lattice nodes
+    bool distance = data->fract->distance;
+    if (ImGui::Checkbox("Distance Field Surface", &distance)) {
+      data->fract->distance = distance;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Bisection steps along each crossing edge, 0 to place vertices directly
+    int refine = (int)data->fract->refine;
+    if (ImGui::SliderInt("Edge Refinement", &refine, 0, 8)) {
+      data->fract->refine = (uint)refine;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Adaptive sampling from bricks of this many cells, below 2 samples all
+    int brick = (int)data->fract->brick;
+    if (ImGui::SliderInt("Adaptive Brick Size", &brick, 0, 32)) {
+      data->fract->brick = (uint)brick;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Surface following from seed lines this many cells apart, 0 scans all
+    int follow = (int)data->fract->follow;
+    if (ImGui::SliderInt("Surface Following Seeds", &follow, 0, 32)) {
+      data->fract->follow = (uint)follow;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
+    // Bricks interval arithmetic proves inside or outside are not sampled
+    int cull = (int)data->fract->cull;
+    if (ImGui::SliderInt("Interval Culling Brick", &cull, 0, 32)) {
+      data->fract->cull = (uint)cull;
+      gui_apply_fractal_changes(data, gui_state);
+    }
+
     ImGui::Separator();
 
     // Performance options
@@ -181,6 +248,11 @@ void gui_render_fractal_controls(t_data *data, t_gui_state *gui_state) {
       printf("Optimization mode changed - restart required for full effect\n");
     }
 
+    // Meshes shown before, kept to show again without a rebuild, 0 keeps none
+    int cache_mb = (int)(data->cache.limit >> 20);
+    if (ImGui::SliderInt("Mesh Cache (MB)", &cache_mb, 0, 2048))
+      mesh_cache_limit(&data->cache, (size_t)cache_mb << 20);
+
     if (ImGui::Button("Regenerate Fractal")) {
       gui_apply_fractal_changes(data, gui_state);
     }
@@ -259,7 +331,77 @@ void gui_render_rendering_controls(t_data *data, t_gui_state *gui_state) {
   ImGui::End();
 }
 
+// Stage times of the last build shown, and their history over the builds
+// before it. Stage times are summed over threads, see stats.c.
+static void gui_render_build_stats(t_data *data, t_gui_state *gui_state) {
+  static const char *names[STAGE_COUNT] = {
+      "Sampling", "Classification", "Triangle Emission",
+      "Concatenation", "gl_retrieve_tris", "VBO Upload"};
+  t_stats *s = &data->stats;
+
+  if (s->builds != gui_state->builds_seen) {
+    gui_state->builds_seen = s->builds;
+    for (int k = 0; k < STAGE_COUNT; k++)
+      gui_state->stage_history[k][gui_state->stage_pos] = s->ns[k] * 1e-6f;
+    gui_state->stage_pos = (gui_state->stage_pos + 1) % PERF_HISTORY;
+  }
+  ImGui::Separator();
+  ImGui::Text("Last Build (%lu shown)", s->builds);
+  ImGui::Text("Generation: %.1f ms wall", s->seconds * 1e3);
+  for (int k = 0; k < STAGE_COUNT; k++) {
+    char overlay[64];
+
+    snprintf(overlay, sizeof(overlay), "%s %.2f ms", names[k],
+             s->ns[k] * 1e-6);
+    ImGui::PlotLines("##stage", gui_state->stage_history[k], PERF_HISTORY,
+                     gui_state->stage_pos, overlay, 0.0f, FLT_MAX,
+                     ImVec2(0, 30));
+  }
+  if (s->seconds > 0.0) {
+    ImGui::Text("Julia Evaluations: %.1f M/s", s->evals / s->seconds * 1e-6);
+    ImGui::Text("Triangles: %.1f M/s", s->tris / s->seconds * 1e-6);
+  }
+  ImGui::Text("Mesh Allocations: %lu", s->allocs);
+}
+
+// CPU and GPU time of each pass of the frame, and what it drew. GPU times
+// arrive FRAME_QUERIES frames late, so they are of an earlier frame.
+static void gui_render_frame_profile(t_data *data, t_gui_state *gui_state) {
+  t_frame_prof *p = &data->gl->prof;
+
+  ImGui::Separator();
+  ImGui::Text("Frame Profile");
+  ImGui::Text("CPU: %.2f ms", p->last_cpu_ms);
+  if (!p->timer_queries)
+    ImGui::Text("GPU: timer queries unsupported");
+  else if (p->gpu_frame || p->frame > FRAME_QUERIES) {
+    if (p->gpu_frame != gui_state->gpu_frame_seen) {
+      gui_state->gpu_frame_seen = p->gpu_frame;
+      gui_state->gpu_history[gui_state->gpu_pos] =
+          (float)(p->gpu_ms[PASS_FRACTAL] + p->gpu_ms[PASS_GUI]);
+      gui_state->gpu_pos = (gui_state->gpu_pos + 1) % PERF_HISTORY;
+    }
+    ImGui::Text("GPU: %.2f ms (fractal %.2f, GUI %.2f)",
+                p->gpu_ms[PASS_FRACTAL] + p->gpu_ms[PASS_GUI],
+                p->gpu_ms[PASS_FRACTAL], p->gpu_ms[PASS_GUI]);
+    ImGui::PlotLines("##gpu", gui_state->gpu_history, PERF_HISTORY,
+                     gui_state->gpu_pos, "GPU ms", 0.0f, FLT_MAX,
+                     ImVec2(0, 40));
+    ImGui::Text("Results dropped: %lu", p->dropped);
+  }
+  ImGui::Text("Fractal Indices: %u", p->last_indices);
+  ImGui::Text("GUI Vertices: %u", p->last_gui_verts);
+  gui_state->log_frames = p->csv != NULL;
+  if (ImGui::Checkbox("Log Frame Times (frame_times.csv)",
+                      &gui_state->log_frames))
+    gl_prof_log(data->gl, gui_state->log_frames ? "frame_times.csv" : NULL);
+}
+
 void gui_render_performance_window(t_data *data, t_gui_state *gui_state) {
+  // Builds are only profiled while someone is looking, unless --stats
+  data->fract->stats = data->profile || gui_state->show_performance_window
+                           ? &data->stats
+                           : NULL;
   if (!gui_state->show_performance_window)
     return;
 
@@ -272,34 +414,61 @@ void gui_render_performance_window(t_data *data, t_gui_state *gui_state) {
 
     ImGui::Text("FPS: %.1f", io.Framerate);
     ImGui::Text("Frame Time: %.3f ms", 1000.0f / io.Framerate);
+    ImGui::PlotLines("##frames", gui_state->frame_history, PERF_HISTORY,
+                     gui_state->frame_pos, "frame ms", 0.0f, FLT_MAX,
+                     ImVec2(0, 40));
+    ImGui::Text("CPU Kernels: %s", kernels_name());
+    if (data->gl)
+      gui_render_frame_profile(data, gui_state);
 
     ImGui::Separator();
     ImGui::Text("Fractal Statistics");
 
     if (data->gl) {
       ImGui::Text("Triangles: %d", data->gl->num_tris);
-      ImGui::Text("Vertices: %d", data->gl->num_pts);
+      ImGui::Text("Vertices: %d", data->gl->num_pts / 3);
     }
+    if (regen_busy(data))
+      ImGui::Text("Regenerating in background...");
 
     if (data->fract) {
       ImGui::Text("Grid Size: %.0f", data->fract->grid_size);
       ImGui::Text("Iterations: %d", data->fract->julia->max_iter);
     }
 
+    ImGui::Separator();
+    ImGui::Text("Mesh Cache");
+    unsigned long lookups = data->cache.hits + data->cache.misses;
+    ImGui::Text("Hits: %lu  Misses: %lu (%.0f%% hit)", data->cache.hits,
+                data->cache.misses,
+                lookups ? 100.0 * data->cache.hits / lookups : 0.0);
+    ImGui::Text("Meshes: %u  Evicted: %lu", data->cache.len,
+                data->cache.evictions);
+    ImGui::Text("Memory: %.1f / %.0f MB", data->cache.bytes / 1048576.0,
+                data->cache.limit / 1048576.0);
+
+    gui_render_build_stats(data, gui_state);
+
     ImGui::Separator();
     ImGui::Text("Memory Usage");
 
-    // Simple memory estimation
+    // Buffers this thread holds; the lattice only exists during a build
     if (data->gl && data->fract) {
-      size_t triangle_memory =
-          data->gl->num_tris * sizeof(float) * 9; // 3 vertices * 3 coords
-      size_t grid_memory = data->fract->grid_size * data->fract->grid_size *
-                           data->fract->grid_size * 8 * sizeof(float);
-
-      ImGui::Text("Triangle Data: %.2f KB", triangle_memory / 1024.0f);
-      ImGui::Text("Grid Data: %.2f KB", grid_memory / 1024.0f);
-      ImGui::Text("Total Est.: %.2f KB",
-                  (triangle_memory + grid_memory) / 1024.0f);
+      t_mesh *mesh = &data->mesh;
+      size_t mesh_memory = (size_t)mesh->vert_capacity * sizeof(float3) +
+                           (size_t)mesh->end_capacity * sizeof(float3) +
+                           (size_t)mesh->face_capacity +
+                           (size_t)mesh->tri_capacity * 3 * sizeof(uint);
+      size_t draw_memory = data->gl->num_pts * sizeof(float);
+      size_t orbit_memory =
+          data->orbit.nodes * (4 * sizeof(float) + sizeof(uint));
+
+      ImGui::Text("Mesh: %.2f MB", mesh_memory / 1048576.0);
+      ImGui::Text("Vertex Positions: %.2f MB", draw_memory / 1048576.0);
+      ImGui::Text("Orbit Cache: %.2f MB", orbit_memory / 1048576.0);
+      ImGui::Text("Lattice (while building): %.2f MB",
+                  data->stats.lattice_bytes / 1048576.0);
+      ImGui::Text("Peak RSS: %.1f MB", stats_peak_rss() / 1048576.0);
     }
 
     ImGui::Separator();
@@ -325,10 +494,13 @@ void gui_apply_fractal_changes(t_data *data, t_gui_state *gui_state) {
   data->fract->julia->max_iter = gui_state->max_iterations;
 
   // Update Julia set parameters (quaternion c)
-  // Note: This requires the data structure to support quaternion parameters
-  // For now, we'll just update what we can
+  data->fract->julia->c.x = gui_state->julia_c[0];
+  data->fract->julia->c.y = gui_state->julia_c[1];
+  data->fract->julia->c.z = gui_state->julia_c[2];
+  data->fract->julia->c.w = gui_state->julia_c[3];
 
-  // Trigger regeneration
+  // Trigger regeneration, at full resolution unless a slider asks otherwise
+  data->preview = 0;
   data->needs_regeneration = 1;
 }
 
@@ -365,6 +537,12 @@ void gui_new_frame_c() { gui_new_frame(); }
 
 void gui_render_c() { gui_render(); }
 
+int gui_vertices_c() {
+  ImDrawData *draw = ImGui::GetDrawData();
+
+  return draw ? draw->TotalVtxCount : 0;
+}
+
 void gui_render_all_c(t_data *data) {
   // Sync GUI state with OpenGL state
   if (data && data->gl) {
@@ -380,6 +558,17 @@ void gui_render_all_c(t_data *data) {
     gui_state.edge_color[1] = data->gl->line_color[1];
     gui_state.edge_color[2] = data->gl->line_color[2];
   }
+  if (data && data->fract && data->fract->julia) {
+    gui_state.max_iterations = (int)data->fract->julia->max_iter;
+    gui_state.julia_c[0] = data->fract->julia->c.x;
+    gui_state.julia_c[1] = data->fract->julia->c.y;
+    gui_state.julia_c[2] = data->fract->julia->c.z;
+    gui_state.julia_c[3] = data->fract->julia->c.w;
+  }
+
+  ImGuiIO &io = ImGui::GetIO();
+  gui_state.frame_history[gui_state.frame_pos] = io.DeltaTime * 1000.0f;
+  gui_state.frame_pos = (gui_state.frame_pos + 1) % PERF_HISTORY;
 
   gui_render_main_menu(data, &gui_state);
   gui_render_fractal_controls(data, &gui_state);
@@ -17,12 +17,31 @@ t_fract						*init_fract(void)
 
 	fract->grid_length = 3.0f;
 	fract->grid_size = 0.0f;
+	fract->cells.x = 0;
+	fract->cells.y = 0;
+	fract->cells.z = 0;
 
 	fract->grid.x = NULL;
 	fract->grid.y = NULL;
 	fract->grid.z = NULL;
 
 	fract->step_size = 0.05f;
+	fract->stream = 0;
+	fract->threads = 0;
+	fract->distance = 0;
+	fract->refine = 0;
+	fract->brick = 0;
+	fract->guard = 1;
+	fract->follow = 0;
+	fract->cull = 0;
+	fract->symmetry = 0;
+	fract->fit = 0;
+	fract->packed = 0;
+	fract->morton = 0;
+	fract->orbits = 0;
+	fract->cancel = NULL;
+	fract->stats = NULL;
+	fract->culled.state = NULL;
 
 	fract->julia = init_julia();
 	return fract;
@@ -36,6 +55,7 @@ t_julia 					*init_julia(void)
 		error(MALLOC_FAIL_ERR, NULL);
 
 	julia->max_iter = 6;
+	julia->exponent = 2;
 	julia->threshold = 2.0f;
 	julia->w = 0.0f;
 
@@ -55,9 +75,17 @@ t_data						*init_data(void)
 		error(MALLOC_FAIL_ERR, NULL);
 	data->gl = init_gl_struct();
 	data->fract = init_fract();
-	data->vertexpos = NULL;
+	memset(&data->stats, 0, sizeof(t_stats));
+	data->profile = 0;
 	data->vertexval = NULL;
-	data->triangles = NULL;
+	data->occupied = NULL;
+	data->preview = 0;
+	data->build_seconds = 0.0;
+	data->build_step = 0.0f;
+	data->regen = NULL;
+	mesh_init(&data->mesh);
+	orbit_init(&data->orbit);
+	mesh_cache_init(&data->cache, (size_t)MESH_CACHE_MB << 20);
 	return data;
 }
 
@@ -65,9 +93,8 @@ void						init_vertex(t_data *data)
 {
 	size_t 					size;
 
-	size = pow(data->fract->grid_size, 3) * 8;
-	if (!(data->vertexpos = (float3 *)malloc(size * sizeof(float3))))
-		error(MALLOC_FAIL_ERR, data);
+	size = lattice_nodes(data->fract);
+	clean_calcs(data);
 	if (!(data->vertexval = (float *)malloc(size * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
 }
@@ -77,10 +104,15 @@ void						init_grid(t_data *data)
 	t_fract 				*f;
 
 	f = data->fract;
-	if (!(f->grid.x = (float *)malloc(((size_t)f->grid_size + 1) * sizeof(float))))
+	free(f->grid.x);
+	free(f->grid.y);
+	free(f->grid.z);
+	f->grid.y = NULL;
+	f->grid.z = NULL;
+	if (!(f->grid.x = (float *)malloc((f->cells.x + 1) * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
-	if (!(f->grid.y = (float *)malloc(((size_t)f->grid_size + 1) * sizeof(float))))
+	if (!(f->grid.y = (float *)malloc((f->cells.y + 1) * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
-	if (!(f->grid.z = (float *)malloc(((size_t)f->grid_size + 1) * sizeof(float))))
+	if (!(f->grid.z = (float *)malloc((f->cells.z + 1) * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
 }
@@ -0,0 +1,264 @@
+#include "morphosis.h"
+#include <float.h>
+
+// Interval culling: each brick of the lattice is iterated once as a box of
+// quaternions in interval arithmetic. If |z|^2 of the whole box passes the
+// escape radius at some iteration, every node in it is outside; if it stays
+// within the radius to max_iter, every node is inside. sample_plane then
+// samples only the nodes no brick decides.
+//
+// The box bounds the exact orbits, not the float ones the kernels compute,
+// so every step widens it by INTERVAL_SLACK of the magnitudes involved and
+// the radius test keeps the same margin.
+
+static t_interval iv(double lo, double hi) {
+  t_interval r;
+
+  r.lo = lo < hi ? lo : hi;
+  r.hi = lo < hi ? hi : lo;
+  return r;
+}
+
+static t_interval iv_add(t_interval a, t_interval b) {
+  return iv(a.lo + b.lo, a.hi + b.hi);
+}
+
+static t_interval iv_sub(t_interval a, t_interval b) {
+  return iv(a.lo - b.hi, a.hi - b.lo);
+}
+
+static t_interval iv_mul(t_interval a, t_interval b) {
+  double p[4] = {a.lo * b.lo, a.lo * b.hi, a.hi * b.lo, a.hi * b.hi};
+  t_interval r = {p[0], p[0]};
+
+  for (int i = 1; i < 4; i++) {
+    r.lo = p[i] < r.lo ? p[i] : r.lo;
+    r.hi = p[i] > r.hi ? p[i] : r.hi;
+  }
+  return r;
+}
+
+// Tighter than iv_mul(a, a), a square never being negative
+static t_interval iv_sqr(t_interval a) {
+  double lo = a.lo * a.lo;
+  double hi = a.hi * a.hi;
+
+  if (a.lo <= 0.0 && a.hi >= 0.0)
+    return iv(0.0, lo > hi ? lo : hi);
+  return iv(lo, hi);
+}
+
+static t_interval iv_widen(t_interval a, double by) {
+  return iv(a.lo - by, a.hi + by);
+}
+
+// cl_quat_square and cl_quat_mult over boxes
+static t_iquat iq_square(t_iquat q) {
+  t_iquat r;
+  t_interval two = {2.0, 2.0};
+
+  r.x = iv_sub(iv_sub(iv_sub(iv_sqr(q.x), iv_sqr(q.y)), iv_sqr(q.z)),
+               iv_sqr(q.w));
+  r.y = iv_mul(two, iv_mul(q.x, q.y));
+  r.z = iv_mul(two, iv_mul(q.x, q.z));
+  r.w = iv_mul(two, iv_mul(q.x, q.w));
+  return r;
+}
+
+static t_iquat iq_mult(t_iquat a, t_iquat b) {
+  t_iquat r;
+
+  r.x = iv_sub(iv_sub(iv_sub(iv_mul(a.x, b.x), iv_mul(a.y, b.y)),
+                      iv_mul(a.z, b.z)),
+               iv_mul(a.w, b.w));
+  r.y = iv_sub(iv_add(iv_add(iv_mul(a.x, b.y), iv_mul(a.y, b.x)),
+                      iv_mul(a.z, b.w)),
+               iv_mul(a.w, b.z));
+  r.z = iv_sub(iv_add(iv_add(iv_mul(a.x, b.z), iv_mul(a.z, b.x)),
+                      iv_mul(a.w, b.y)),
+               iv_mul(a.y, b.w));
+  r.w = iv_sub(iv_add(iv_add(iv_mul(a.x, b.w), iv_mul(a.w, b.x)),
+                      iv_mul(a.y, b.z)),
+               iv_mul(a.z, b.y));
+  return r;
+}
+
+static t_interval iq_mod2(t_iquat q) {
+  return iv_add(iv_add(iv_sqr(q.x), iv_sqr(q.y)),
+                iv_add(iv_sqr(q.z), iv_sqr(q.w)));
+}
+
+// BRICK_ESCAPES, BRICK_BOUNDED or 0 for the box of points z
+static uchar iterate_box(t_julia *julia, t_iquat z) {
+  double escape2 = (double)julia->threshold * julia->threshold;
+  double cmag = fabs(julia->c.x) + fabs(julia->c.y) + fabs(julia->c.z) +
+                fabs(julia->c.w);
+  t_interval m = iq_mod2(z);
+  t_iquat p;
+  double slack;
+
+  for (uint iter = 0; iter < julia->max_iter; iter++) {
+    slack = INTERVAL_SLACK * (pow(m.hi, 0.5 * julia->exponent) + cmag);
+    p = iq_square(z);
+    for (uint k = 2; k < julia->exponent; k++)
+      p = iq_mult(p, z);
+    z.x = iv_widen(iv_add(p.x, iv(julia->c.x, julia->c.x)), slack);
+    z.y = iv_widen(iv_add(p.y, iv(julia->c.y, julia->c.y)), slack);
+    z.z = iv_widen(iv_add(p.z, iv(julia->c.z, julia->c.z)), slack);
+    z.w = iv_widen(iv_add(p.w, iv(julia->c.w, julia->c.w)), slack);
+    m = iq_mod2(z);
+    if (m.lo > escape2 * (1.0 + INTERVAL_SLACK))
+      return BRICK_ESCAPES;
+    if (!(m.hi < DBL_MAX))
+      return 0;
+  }
+  return m.hi < escape2 * (1.0 - INTERVAL_SLACK) ? BRICK_BOUNDED : 0;
+}
+
+static t_interval brick_axis(const float *grid, uint b, uint size,
+                             uint cells) {
+  uint lo = b * size;
+  uint hi = lo + size < cells ? lo + size : cells;
+
+  return iv(grid[lo], grid[hi]);
+}
+
+// Decides every brick for the Julia samplers, whose results culling
+// reproduces; any other sampler, or culling turned off, drops the verdicts
+void cull_bricks(t_data *data, t_sampler sampler) {
+  t_fract *f = data->fract;
+  t_bricks *lv = &f->culled;
+  size_t n;
+
+  free(lv->state);
+  lv->state = NULL;
+  if (!f->cull || (sampler != sample_4D_Julia_row &&
+                   sampler != sample_4D_Julia_distance_row))
+    return;
+  lv->size = f->cull;
+  lv->count.x = (f->cells.x + lv->size - 1) / lv->size;
+  lv->count.y = (f->cells.y + lv->size - 1) / lv->size;
+  lv->count.z = (f->cells.z + lv->size - 1) / lv->size;
+  n = (size_t)lv->count.x * lv->count.y * lv->count.z;
+  if (!(lv->state = (uchar *)malloc(n)))
+    error(MALLOC_FAIL_ERR, data);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64) num_threads(lattice_threads(f))
+#endif
+  for (size_t i = 0; i < n; i++) {
+    t_iquat z;
+
+    z.x = brick_axis(f->grid.x, (uint)(i % lv->count.x), lv->size,
+                     f->cells.x);
+    z.y = brick_axis(f->grid.y, (uint)(i / lv->count.x % lv->count.y),
+                     lv->size, f->cells.y);
+    z.z = brick_axis(f->grid.z, (uint)(i / lv->count.x / lv->count.y),
+                     lv->size, f->cells.z);
+    z.w = iv(f->julia->w, f->julia->w);
+    lv->state[i] = iterate_box(f->julia, z);
+  }
+}
+
+// Bricks holding node k of an axis: k / size, and the one below as well
+// when k lies on the face between them
+static void node_bricks(uint k, uint size, uint count, uint *first,
+                        uint *last) {
+  *last = k / size < count ? k / size : count - 1;
+  *first = k % size == 0 && k && *last == k / size ? *last - 1 : *last;
+}
+
+// Verdict of a node held by bricks of verdicts a and b: BRICK_BOUNDED if
+// either is bounded, BRICK_ESCAPES if either escapes or, for distance
+// samples, if both do, since a node next to an undecided brick may need its
+// distance to place a vertex
+static uchar node_verdict(int distance, uchar a, uchar b) {
+  if (!distance)
+    return a | b;
+  return (uchar)((a & (b | BRICK_BOUNDED)) | ((a | b) & BRICK_BOUNDED));
+}
+
+// Verdict of every node of row y of plane z, from the up to four bricks
+// holding the row next to each x
+static void cull_row(t_fract *f, int distance, uint y, uint z, uchar *verdict,
+                     uchar *col) {
+  t_bricks *lv = &f->culled;
+  uint y0;
+  uint y1;
+  uint z0;
+  uint z1;
+  uint x;
+
+  node_bricks(y, lv->size, lv->count.y, &y0, &y1);
+  node_bricks(z, lv->size, lv->count.z, &z0, &z1);
+  for (uint bx = 0; bx < lv->count.x; bx++) {
+    col[bx] = lv->state[((size_t)z0 * lv->count.y + y0) * lv->count.x + bx];
+    for (uint bz = z0; bz <= z1; bz++)
+      for (uint by = y0; by <= y1; by++)
+        col[bx] = node_verdict(
+            distance, col[bx],
+            lv->state[((size_t)bz * lv->count.y + by) * lv->count.x + bx]);
+  }
+  x = 0;
+  for (uint bx = 0; bx < lv->count.x; bx++)
+    for (uint k = 0; k < lv->size && x < f->cells.x; k++)
+      verdict[x++] = col[bx];
+  verdict[f->cells.x] = col[lv->count.x - 1];
+  for (uint bx = 1; bx < lv->count.x; bx++)
+    verdict[bx * lv->size] =
+        node_verdict(distance, col[bx - 1], col[bx]);
+}
+
+// Samples one plane of nodes, leaving out those the bricks decide. Returns
+// 0 for the caller to sample the plane whole when culling is off or there
+// is no memory for it.
+int cull_plane(t_fract *f, t_sampler sampler, uint z, float *val) {
+  size_t row = f->cells.x + 1;
+  int distance = sampler == sample_4D_Julia_distance_row;
+  uchar *verdict;
+  float *xs;
+  float *out;
+  uint *at;
+  uint n;
+  double start;
+
+  if (!f->culled.state)
+    return 0;
+  verdict = (uchar *)malloc(row + f->culled.count.x);
+  xs = (float *)malloc(row * sizeof(float));
+  out = (float *)malloc(row * sizeof(float));
+  at = (uint *)malloc(row * sizeof(uint));
+  if (!verdict || !xs || !out || !at) {
+    free(verdict);
+    free(xs);
+    free(out);
+    free(at);
+    return 0;
+  }
+  for (uint y = 0; y <= f->cells.y; y++, val += row) {
+    cull_row(f, distance, y, z, verdict, verdict + row);
+    n = 0;
+    for (uint x = 0; x < row; x++) {
+      if (verdict[x] & BRICK_BOUNDED)
+        val[x] = 1.0f;
+      else if (verdict[x] & BRICK_ESCAPES)
+        val[x] = distance ? -FLT_MAX : 0.0f;
+      else {
+        xs[n] = f->grid.x[x];
+        at[n++] = x;
+      }
+    }
+    if (n) {
+      start = stats_clock(f);
+      sampler(f->julia, xs, f->grid.y[y], f->grid.z[z], n, out);
+      stats_add(f, STAGE_SAMPLE, start);
+      stats_evals(f, n);
+    }
+    for (uint i = 0; i < n; i++)
+      val[at[i]] = out[i];
+  }
+  free(verdict);
+  free(xs);
+  free(out);
+  free(at);
+  return 1;
+}
@@ -0,0 +1,132 @@
+#include "morphosis.h"
+
+// Runtime CPU dispatch: kernels.inc is compiled once for baseline x86-64
+// (or whatever the build targets elsewhere) and, on x86-64, again for AVX2
+// and AVX-512. kernels_select picks the best set the CPU and OS support at
+// startup, so one binary runs everywhere without -march=native.
+//
+// Contraction into FMA is disabled so every instruction set rounds the same
+// way and the mesh does not depend on the host.
+
+#if defined(__clang__)
+#pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#pragma GCC optimize("fp-contract=off")
+#endif
+
+#define KERNEL(name) name##_base
+#define KERNEL_TARGET
+#define KERNEL_LANES 8
+#include "kernels.inc"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define KERNEL_DISPATCH
+
+#define KERNEL(name) name##_avx2
+#define KERNEL_TARGET __attribute__((target("avx2")))
+#define KERNEL_LANES 8
+#include "kernels.inc"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+
+#define KERNEL(name) name##_avx512
+#define KERNEL_TARGET __attribute__((target("avx512f,avx512bw,avx512vl")))
+#define KERNEL_LANES 16
+#include "kernels.inc"
+#undef KERNEL
+#undef KERNEL_TARGET
+#undef KERNEL_LANES
+#endif
+
+static const t_kernels g_kernels[] = {
+    {"baseline", sample_row_base, classify_row_base, orbit_row_base,
+     distance_row_base, sample_points_base},
+#ifdef KERNEL_DISPATCH
+    {"avx2", sample_row_avx2, classify_row_avx2, orbit_row_avx2,
+     distance_row_avx2, sample_points_avx2},
+    {"avx512", sample_row_avx512, classify_row_avx512, orbit_row_avx512,
+     distance_row_avx512, sample_points_avx512},
+#endif
+};
+
+#define KERNEL_SETS (sizeof(g_kernels) / sizeof(g_kernels[0]))
+
+static const t_kernels *g_active = g_kernels;
+
+static int kernels_supported(uint i) {
+#ifdef KERNEL_DISPATCH
+  __builtin_cpu_init();
+  if (i == 1)
+    return __builtin_cpu_supports("avx2");
+  if (i == 2)
+    return __builtin_cpu_supports("avx512f") &&
+           __builtin_cpu_supports("avx512bw") &&
+           __builtin_cpu_supports("avx512vl");
+#endif
+  return i == 0;
+}
+
+// Picks the named kernel set, or the best supported one when name is NULL
+// or unknown. A set the CPU cannot run falls back to the best one it can.
+const t_kernels *kernels_select(const char *name) {
+  uint best;
+
+  best = 0;
+  for (uint i = 0; i < KERNEL_SETS; i++)
+    if (kernels_supported(i))
+      best = i;
+  g_active = g_kernels + best;
+  if (!name)
+    return g_active;
+  for (uint i = 0; i < KERNEL_SETS; i++) {
+    if (strcmp(name, g_kernels[i].name))
+      continue;
+    if (kernels_supported(i))
+      g_active = g_kernels + i;
+    else
+      printf("%s kernels are not supported here, using %s\n", name,
+             g_active->name);
+    return g_active;
+  }
+  printf("Unknown kernel set %s, using %s\n", name, g_active->name);
+  return g_active;
+}
+
+// Every kernel set by index, NULL past the last one or if the CPU cannot
+// run it
+const t_kernels *kernels_get(uint i) {
+  if (i >= KERNEL_SETS || !kernels_supported(i))
+    return NULL;
+  return g_kernels + i;
+}
+
+const char *kernels_name(void) { return g_active->name; }
+
+void sample_4D_Julia_row(t_julia *julia, const float *x, float y, float z,
+                         uint n, float *out) {
+  g_active->sample_row(julia, x, y, z, n, out);
+}
+
+uint classify_row(const float *lo, const float *hi, size_t row, uint n,
+                  uchar *cube, uint *active) {
+  return g_active->classify_row(lo, hi, row, n, cube, active);
+}
+
+void orbit_row(t_julia *julia, float **z, uint *escape, uint n, uint from,
+               uint to) {
+  g_active->orbit_row(julia, z, escape, n, from, to);
+}
+
+void sample_4D_Julia_distance_row(t_julia *julia, const float *x, float y,
+                                  float z, uint n, float *out) {
+  g_active->distance_row(julia, x, y, z, n, out);
+}
+
+void sample_4D_Julia_points(t_julia *julia, const float *x, const float *y,
+                            const float *z, uint n, float *out) {
+  g_active->sample_points(julia, x, y, z, n, out);
+}
@@ -0,0 +1,61 @@
+#include "morphosis.h"
+
+// Shared-lattice sampling: the Julia set is evaluated once per grid node and
+// every cell reads its eight corners from the node planes by index.
+
+size_t lattice_plane(t_fract *f) {
+  return (size_t)(f->cells.x + 1) * (f->cells.y + 1);
+}
+
+// Streaming generation only ever holds the two planes bounding the current
+// layer of cells of each slab, packed occupancy one scratch plane per slab,
+// the full lattice keeps every plane
+size_t lattice_nodes(t_fract *f) {
+  if (f->stream)
+    return lattice_plane(f) * 2 * slab_count(f);
+  if (lattice_packed(f))
+    return lattice_plane(f) * slab_count(f);
+  return lattice_plane(f) * (f->cells.z + 1);
+}
+
+size_t lattice_index(t_fract *f, uint x, uint y) {
+  return (size_t)y * (f->cells.x + 1) + x;
+}
+
+// Rows are handed to the sampler whole, grid.x already being the x
+// coordinates of the row in structure-of-arrays form, unless interval
+// culling leaves only part of them to sample. A cancelled build leaves the
+// plane as it is.
+void sample_plane(t_fract *f, t_sampler sampler, uint z, float *val) {
+  size_t row = f->cells.x + 1;
+  double start;
+
+  if (generation_cancelled(f) || cull_plane(f, sampler, z, val))
+    return;
+  start = stats_clock(f);
+  for (uint y = 0; y <= f->cells.y; y++)
+    sampler(f->julia, f->grid.x, f->grid.y[y], f->grid.z[z], row,
+            val + y * row);
+  stats_add(f, STAGE_SAMPLE, start);
+  stats_evals(f, row * (f->cells.y + 1));
+}
+
+// Distance sampling costs a few multiplies per iteration more but lets
+// marching cubes place vertices between nodes instead of on them
+t_sampler lattice_sampler(t_fract *f) {
+  if (f->distance)
+    return sample_4D_Julia_distance_row;
+  return sample_4D_Julia_row;
+}
+
+// Planes are independent, and their cost varies with how much of the set
+// they cut, so threads pick them up one at a time
+void sample_lattice(t_data *data, t_sampler sampler) {
+  t_fract *f = data->fract;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f))
+#endif
+  for (uint z = 0; z <= f->cells.z; z++)
+    sample_plane(f, sampler, z, data->vertexval + z * lattice_plane(f));
+}
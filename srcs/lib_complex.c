@@ -121,7 +121,23 @@ cl_quat			cl_quat_mult(cl_quat q1, cl_quat q2)
 	res.x = (q1.x * q2.x) - (q1.y * q2.y) - (q1.z * q2.z) - (q1.w * q2.w);
 	res.y = (q1.x * q2.y) + (q1.y * q2.x) + (q1.z * q2.w) - (q1.w * q2.z);
 	res.z = (q1.x * q2.z) + (q1.z * q2.x) + (q1.w * q2.y) - (q1.y * q2.w);
-	res.w = (q1.x * q1.w) + (q1.w * q2.x) + (q1.y * q2.z) - (q1.z * q2.y);
+	res.w = (q1.x * q2.w) + (q1.w * q2.x) + (q1.y * q2.z) - (q1.z * q2.y);
+	return res;
+}
+
+/*
+** Closed form of cl_quat_mult(q, q): the cross terms of the vector part
+** cancel, leaving twice the real part times each imaginary component.
+*/
+
+cl_quat			cl_quat_square(cl_quat q)
+{
+	cl_quat 	res;
+
+	res.x = (q.x * q.x) - (q.y * q.y) - (q.z * q.z) - (q.w * q.w);
+	res.y = 2 * q.x * q.y;
+	res.z = 2 * q.x * q.z;
+	res.w = 2 * q.x * q.w;
 	return res;
 }
 
@@ -147,6 +163,11 @@ cl_quat 		cl_quat_conjugate(cl_quat q)
 	return res;
 }
 
+TYPE 			cl_quat_mod2(cl_quat q)
+{
+	return ((q.x * q.x) + (q.y * q.y) + (q.z * q.z) + (q.w * q.w));
+}
+
 TYPE 			cl_quat_mod(cl_quat q)
 {
 	cl_quat 	tmp;
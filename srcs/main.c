@@ -1,4 +1,92 @@
 #include "morphosis.h"
+#include <stddef.h>
+
+// Switches accepted anywhere on the command line. Generation switches go
+// straight into t_fract, over the defaults init_fract gave it, once the
+// fractal exists; the rest into t_flags. A switch missing its argument is
+// left for get_args, as a positional argument.
+typedef enum e_flag_kind { FLAG_SET, FLAG_UINT, FLAG_STRING } t_flag_kind;
+
+typedef struct s_flag {
+  const char *name;
+  t_flag_kind kind;
+  int fract; // offset is into t_fract rather than t_flags
+  size_t offset;
+} t_flag;
+
+#define FLAG_MAX 32 // switches g_flags can hold
+
+typedef struct s_flags {
+  char *kernels;
+  uint cache;
+  char *gpu_log;
+  int stats;
+  char *given[FLAG_MAX]; // argument of each generation switch, else NULL
+} t_flags;
+
+static const t_flag g_flags[] = {
+    {"--stream", FLAG_SET, 1, offsetof(t_fract, stream)},
+    {"--threads", FLAG_UINT, 1, offsetof(t_fract, threads)},
+    {"--kernels", FLAG_STRING, 0, offsetof(t_flags, kernels)},
+    {"--distance", FLAG_SET, 1, offsetof(t_fract, distance)},
+    {"--refine", FLAG_UINT, 1, offsetof(t_fract, refine)},
+    {"--adaptive", FLAG_UINT, 1, offsetof(t_fract, brick)},
+    {"--guard", FLAG_UINT, 1, offsetof(t_fract, guard)},
+    {"--follow", FLAG_UINT, 1, offsetof(t_fract, follow)},
+    {"--cull", FLAG_UINT, 1, offsetof(t_fract, cull)},
+    {"--symmetry", FLAG_SET, 1, offsetof(t_fract, symmetry)},
+    {"--fit", FLAG_UINT, 1, offsetof(t_fract, fit)},
+    {"--packed", FLAG_SET, 1, offsetof(t_fract, packed)},
+    {"--morton", FLAG_UINT, 1, offsetof(t_fract, morton)},
+    {"--cache", FLAG_UINT, 0, offsetof(t_flags, cache)},
+    {"--gpu-log", FLAG_STRING, 0, offsetof(t_flags, gpu_log)},
+    {"--stats", FLAG_SET, 0, offsetof(t_flags, stats)},
+};
+
+#define FLAG_COUNT (sizeof(g_flags) / sizeof(g_flags[0]))
+
+static void flag_store(const t_flag *flag, void *base, char *arg) {
+  char *field = (char *)base + flag->offset;
+
+  if (flag->kind == FLAG_SET)
+    *(int *)field = 1;
+  else if (flag->kind == FLAG_UINT)
+    *(uint *)field = (uint)strtoul(arg, NULL, 10);
+  else
+    *(char **)field = arg;
+}
+
+// Strips the recognised switches so get_args only sees positional arguments
+static int take_flags(int argv, char **argc, t_flags *flags) {
+  const t_flag *flag;
+  char *arg;
+  int n;
+
+  n = 1;
+  for (int i = 1; i < argv; i++) {
+    flag = NULL;
+    for (size_t k = 0; k < FLAG_COUNT && !flag; k++)
+      if (!strcmp(argc[i], g_flags[k].name) &&
+          (g_flags[k].kind == FLAG_SET || i + 1 < argv))
+        flag = g_flags + k;
+    if (!flag) {
+      argc[n++] = argc[i];
+      continue;
+    }
+    arg = flag->kind == FLAG_SET ? argc[i] : argc[++i];
+    if (flag->fract)
+      flags->given[flag - g_flags] = arg;
+    else
+      flag_store(flag, flags, arg);
+  }
+  return n;
+}
+
+static void apply_flags(t_fract *f, t_flags *flags) {
+  for (size_t k = 0; k < FLAG_COUNT; k++)
+    if (g_flags[k].fract && flags->given[k])
+      flag_store(g_flags + k, f, flags->given[k]);
+}
 
 static t_data *get_args(int argv, char **argc) {
   t_data *data;
@@ -68,28 +156,52 @@ static t_data *get_args(int argv, char **argc) {
   return data;
 }
 
+// -j builds once and writes JSON instead of opening the window
+static int json_export(int argv, char **argc) {
+  return (argv == 2 || argv == 8) && !strcmp(argc[1], "-j");
+}
+
 int main(int argv, char **argc) {
   t_data *data;
+  t_flags flags;
+  double start;
 
+  memset(&flags, 0, sizeof(t_flags));
+  flags.cache = MESH_CACHE_MB;
+  argv = take_flags(argv, argc, &flags);
+  printf("Using %s kernels\n", kernels_select(flags.kernels)->name);
   data = get_args(argv, argc);
+  apply_flags(data->fract, &flags);
+  // Only the GUI changes max_iter on a lattice already sampled
+  data->fract->orbits = !json_export(argv, argc);
+  mesh_cache_limit(&data->cache, (size_t)flags.cache << 20);
+  if (flags.gpu_log && !gl_prof_log(data->gl, flags.gpu_log))
+    printf("Cannot write frame times to %s\n", flags.gpu_log);
+  data->profile = flags.stats;
+  data->fract->stats = data->profile ? &data->stats : NULL;
 
+  start = stats_now();
 #ifdef OPTIMIZED
   printf("Using OPTIMIZED fractal generation...\n");
   calculate_point_cloud_optimized(data);
 #else
   printf("Using ORIGINAL fractal generation...\n");
   calculate_point_cloud(data);
-  gl_retrieve_tris(data);
-  clean_calcs(data);
 #endif
+  if (!gl_retrieve_tris(data))
+    error(MALLOC_FAIL_ERR, data);
+  clean_calcs(data);
+
+  // The first build calibrates preview steps
+  data->build_seconds = stats_now() - start;
+  data->build_step = data->fract->step_size;
 
   // Set up back-reference for GUI integration
   data->gl->data = data;
   data->needs_regeneration = 0;
 
   // Check if we should export JSON instead of running graphics
-  if ((argv == 2 && !(strcmp(argc[1], "-j"))) ||
-      (argv == 8 && !(strcmp(argc[1], "-j")))) {
+  if (json_export(argv, argc)) {
     printf("\nEXPORTING JSON----\n");
     export_fractal_json(data, "./fractal_data.json");
     printf("JSON EXPORT DONE\n");
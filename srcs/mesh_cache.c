@@ -0,0 +1,205 @@
+#include "morphosis.h"
+
+// Mesh cache: every full-resolution mesh shown is copied here under the
+// parameters it was built from, so returning to them (a preset, "Reset to
+// Default", a slider moved back) shows the mesh again without building it.
+// Entries are few and large, so they sit in one array searched end to end,
+// and the least recently used ones are dropped while the cache holds more
+// than its limit in bytes.
+
+void mesh_cache_init(t_mesh_cache *cache, size_t limit) {
+  memset(cache, 0, sizeof(t_mesh_cache));
+  cache->limit = limit;
+}
+
+static void grid_free(t_grid *grid) {
+  free(grid->x);
+  free(grid->y);
+  free(grid->z);
+}
+
+// Copies the axes of a lattice of cells into dst. Returns 0, with dst left
+// to grid_free, if they cannot be allocated.
+static int grid_copy(t_grid *dst, t_grid *src, uint3 cells) {
+  dst->x = (float *)malloc((cells.x + 1) * sizeof(float));
+  dst->y = (float *)malloc((cells.y + 1) * sizeof(float));
+  dst->z = (float *)malloc((cells.z + 1) * sizeof(float));
+  if (!dst->x || !dst->y || !dst->z)
+    return 0;
+  memcpy(dst->x, src->x, (cells.x + 1) * sizeof(float));
+  memcpy(dst->y, src->y, (cells.y + 1) * sizeof(float));
+  memcpy(dst->z, src->z, (cells.z + 1) * sizeof(float));
+  return 1;
+}
+
+static void entry_free(t_cached_mesh *e) {
+  mesh_free(&e->mesh);
+  free(e->tris);
+  grid_free(&e->grid);
+}
+
+void mesh_cache_free(t_mesh_cache *cache) {
+  for (uint i = 0; i < cache->len; i++)
+    entry_free(cache->entries + i);
+  free(cache->entries);
+  mesh_cache_init(cache, cache->limit);
+}
+
+static void mesh_key(t_fract *f, t_mesh_key *key) {
+  memset(key, 0, sizeof(t_mesh_key));
+  key->c[0] = f->julia->c.x;
+  key->c[1] = f->julia->c.y;
+  key->c[2] = f->julia->c.z;
+  key->c[3] = f->julia->c.w;
+  key->w = f->julia->w;
+  key->threshold = f->julia->threshold;
+  key->exponent = f->julia->exponent;
+  key->max_iter = f->julia->max_iter;
+  key->step = f->step_size;
+  key->p0[0] = f->p0.x;
+  key->p0[1] = f->p0.y;
+  key->p0[2] = f->p0.z;
+  key->p1[0] = f->p1.x;
+  key->p1[1] = f->p1.y;
+  key->p1[2] = f->p1.z;
+  key->distance = f->distance;
+  key->refine = f->refine;
+  key->brick = lattice_adaptive(f) ? f->brick : 0;
+  key->guard = lattice_adaptive(f) ? f->guard : 0;
+  key->follow = f->follow;
+  key->cull = f->cull;
+  key->symmetry = f->symmetry;
+  key->fit = f->fit;
+  key->morton = f->morton;
+}
+
+static t_cached_mesh *entry_find(t_mesh_cache *cache, t_mesh_key *key) {
+  for (uint i = 0; i < cache->len; i++)
+    if (!memcmp(&cache->entries[i].key, key, sizeof(t_mesh_key)))
+      return cache->entries + i;
+  return NULL;
+}
+
+static void entry_drop(t_mesh_cache *cache, uint i) {
+  cache->bytes -= cache->entries[i].bytes;
+  entry_free(cache->entries + i);
+  cache->entries[i] = cache->entries[--cache->len];
+}
+
+// Drops the least recently used entries until bytes more fit under the limit
+static void make_room(t_mesh_cache *cache, size_t bytes) {
+  uint oldest;
+
+  while (cache->len && cache->bytes + bytes > cache->limit) {
+    oldest = 0;
+    for (uint i = 1; i < cache->len; i++)
+      if (cache->entries[i].used < cache->entries[oldest].used)
+        oldest = i;
+    entry_drop(cache, oldest);
+    cache->evictions++;
+  }
+}
+
+void mesh_cache_limit(t_mesh_cache *cache, size_t limit) {
+  cache->limit = limit;
+  make_room(cache, 0);
+}
+
+static size_t mesh_bytes(t_data *data) {
+  return (size_t)data->mesh.num_verts * sizeof(float3) +
+         (size_t)data->mesh.num_tris * 3 * sizeof(uint) +
+         (size_t)data->gl->num_pts * sizeof(float) +
+         ((size_t)data->fract->cells.x + data->fract->cells.y +
+          data->fract->cells.z + 3) * sizeof(float);
+}
+
+// Copies the mesh data shows, built from the parameters in f. A mesh larger
+// than the whole limit, or one failing to copy, is simply not kept.
+void mesh_cache_store(t_mesh_cache *cache, t_fract *f, t_data *data) {
+  t_cached_mesh e;
+  t_cached_mesh *tmp;
+
+  memset(&e, 0, sizeof(t_cached_mesh));
+  mesh_key(f, &e.key);
+  e.bytes = mesh_bytes(data);
+  if ((tmp = entry_find(cache, &e.key)))
+    tmp->used = ++cache->tick;
+  if (tmp || e.bytes > cache->limit)
+    return;
+  make_room(cache, e.bytes);
+  if (cache->len == cache->cap) {
+    if (!(tmp = (t_cached_mesh *)realloc(
+              cache->entries, (cache->cap ? cache->cap * 2 : 8) *
+                                  sizeof(t_cached_mesh))))
+      return;
+    cache->entries = tmp;
+    cache->cap = cache->cap ? cache->cap * 2 : 8;
+  }
+  mesh_init(&e.mesh);
+  e.mesh.verts = (float3 *)malloc(
+      (data->mesh.num_verts ? data->mesh.num_verts : 1) * sizeof(float3));
+  e.mesh.idx = (uint *)malloc(
+      (data->mesh.num_tris ? data->mesh.num_tris : 1) * 3 * sizeof(uint));
+  e.tris = (float *)malloc(
+      (data->gl->num_pts ? data->gl->num_pts : 1) * sizeof(float));
+  if (!e.mesh.verts || !e.mesh.idx || !e.tris ||
+      !grid_copy(&e.grid, &data->fract->grid, data->fract->cells)) {
+    entry_free(&e);
+    return;
+  }
+  memcpy(e.mesh.verts, data->mesh.verts,
+         data->mesh.num_verts * sizeof(float3));
+  memcpy(e.mesh.idx, data->mesh.idx,
+         (size_t)data->mesh.num_tris * 3 * sizeof(uint));
+  memcpy(e.tris, data->gl->tris, data->gl->num_pts * sizeof(float));
+  e.mesh.num_verts = e.mesh.vert_capacity = data->mesh.num_verts;
+  e.mesh.num_tris = e.mesh.tri_capacity = data->mesh.num_tris;
+  e.num_pts = data->gl->num_pts;
+  e.cells = data->fract->cells;
+  e.grid_size = data->fract->grid_size;
+  e.used = ++cache->tick;
+  cache->entries[cache->len++] = e;
+  cache->bytes += e.bytes;
+}
+
+// Puts the mesh cached for the parameters in f into data, ready to upload.
+// Returns 0 on a miss, leaving data as it was.
+int mesh_cache_fetch(t_mesh_cache *cache, t_fract *f, t_data *data) {
+  t_mesh_key key;
+  t_cached_mesh *e;
+  float *tris;
+  t_grid grid;
+
+  mesh_key(f, &key);
+  if (!(e = entry_find(cache, &key))) {
+    cache->misses++;
+    return 0;
+  }
+  mesh_clear(&data->mesh);
+  if (!mesh_reserve(&data->mesh, e->mesh.num_verts, e->mesh.num_tris) ||
+      !(tris = (float *)malloc((e->num_pts ? e->num_pts : 1) *
+                               sizeof(float))))
+    error(MALLOC_FAIL_ERR, data);
+  if (!grid_copy(&grid, &e->grid, e->cells)) {
+    grid_free(&grid);
+    free(tris);
+    error(MALLOC_FAIL_ERR, data);
+  }
+  memcpy(data->mesh.verts, e->mesh.verts, e->mesh.num_verts * sizeof(float3));
+  memcpy(data->mesh.idx, e->mesh.idx,
+         (size_t)e->mesh.num_tris * 3 * sizeof(uint));
+  data->mesh.num_verts = e->mesh.num_verts;
+  data->mesh.num_tris = e->mesh.num_tris;
+  memcpy(tris, e->tris, e->num_pts * sizeof(float));
+  free(data->gl->tris);
+  data->gl->tris = tris;
+  data->gl->num_pts = e->num_pts;
+  data->gl->num_tris = e->mesh.num_tris;
+  grid_free(&data->fract->grid);
+  data->fract->grid = grid;
+  data->fract->cells = e->cells;
+  data->fract->grid_size = e->grid_size;
+  e->used = ++cache->tick;
+  cache->hits++;
+  return 1;
+}
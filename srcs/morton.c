@@ -0,0 +1,115 @@
+#include "morphosis.h"
+
+// Brick order: with --morton n each slab is meshed in runs of n layers of
+// cells. A run is classified whole, then cut into bricks of n x n cells
+// across, which are visited in Morton order of their x and y, each a row of
+// cells at a time. Triangles and their vertices come out in compact patches
+// of surface, together for a GPU vertex cache or any later chunking, with
+// no sort afterwards. The edge cache holds the whole run, so every vertex
+// is still shared by all the cells around its edge. Runs and slabs start on
+// multiples of n, which keeps the order the same whatever the thread count.
+
+int lattice_morton(t_fract *f) {
+  return f->morton && !f->stream && !f->follow;
+}
+
+// Runs of layers the lattice splits into, one per layer unless in bricks
+uint morton_runs(t_fract *f) {
+  if (!lattice_morton(f))
+    return f->cells.z;
+  return (f->cells.z + f->morton - 1) / f->morton;
+}
+
+// Even bits of a Morton code, which give x; the odd ones shifted down give y
+static uint morton_axis(uint m) {
+  m &= 0x55555555u;
+  m = (m | m >> 1) & 0x33333333u;
+  m = (m | m >> 2) & 0x0f0f0f0fu;
+  m = (m | m >> 4) & 0x00ff00ffu;
+  return (m | m >> 8) & 0x0000ffffu;
+}
+
+// Cube index of every cell of layers [z, z + layers) into the slab's cubes
+static void classify_run(t_data *data, t_slab *slab, uint z, uint layers) {
+  t_fract *f = data->fract;
+  uchar *cube = slab->cubes;
+  const float *lo;
+  size_t base;
+
+  for (uint k = z; k < z + layers; k++) {
+    lo = slab->bits ? NULL : data->vertexval + k * lattice_plane(f);
+    for (uint y = 0; y < f->cells.y; y++, cube += f->cells.x) {
+      base = lattice_index(f, 0, y);
+      if (slab->bits)
+        classify_packed_row(f, slab->bits, y, k, cube, slab->active);
+      else
+        classify_row(lo + base, lo + lattice_plane(f) + base, f->cells.x + 1,
+                     f->cells.x, cube, slab->active);
+    }
+  }
+}
+
+// Crossed cells of brick (bx, by) of the run from layer z. Returns 0 if the
+// mesh cannot grow.
+static int mesh_brick(t_data *data, t_slab *slab, uint bx, uint by, uint z,
+                       uint layers) {
+  t_fract *f = data->fract;
+  uint n = f->morton;
+  uint x1 = (bx + 1) * n < f->cells.x ? (bx + 1) * n : f->cells.x;
+  uint y1 = (by + 1) * n < f->cells.y ? (by + 1) * n : f->cells.y;
+  const uchar *row;
+  uint3 cell;
+
+  for (uint k = 0; k < layers; k++) {
+    cell.z = z + k;
+    slab->edges.layer = k;
+    if (!slab->bits) {
+      slab->planes[0] = data->vertexval + cell.z * lattice_plane(f);
+      slab->planes[1] = slab->planes[0] + lattice_plane(f);
+    }
+    for (cell.y = by * n; cell.y < y1; cell.y++) {
+      if (!mesh_reserve(slab->mesh, (x1 - bx * n) * MC_MAX_VERTS,
+                        (x1 - bx * n) * MC_MAX_TRIS))
+        return 0;
+      row = slab->cubes + ((size_t)k * f->cells.y + cell.y) * f->cells.x;
+      for (cell.x = bx * n; cell.x < x1; cell.x++)
+        if ((uchar)(row[cell.x] + 1) > 1)
+          polygonise(f, slab, cell, row[cell.x]);
+    }
+  }
+  return 1;
+}
+
+// polygonise_lattice in brick order. The Morton codes cover a power of two
+// square of bricks; codes falling outside the lattice are skipped.
+int polygonise_bricks(t_data *data, t_slab *slab) {
+  t_fract *f = data->fract;
+  uint n = f->morton;
+  uint bricks[2] = {(f->cells.x + n - 1) / n, (f->cells.y + n - 1) / n};
+  size_t side;
+  double start;
+  uint layers;
+  uint bx;
+  uint by;
+
+  side = 1;
+  while (side < bricks[0] || side < bricks[1])
+    side *= 2;
+  for (uint z = slab->z0; z < slab->z1 && !generation_cancelled(f);
+       z += layers) {
+    layers = slab->z1 - z < n ? slab->z1 - z : n;
+    start = stats_clock(f);
+    classify_run(data, slab, z, layers);
+    start = stats_add(f, STAGE_CLASSIFY, start);
+    for (size_t m = 0; m < side * side; m++) {
+      bx = morton_axis((uint)m);
+      by = morton_axis((uint)(m >> 1));
+      if (bx < bricks[0] && by < bricks[1] &&
+          !mesh_brick(data, slab, bx, by, z, layers))
+        return 0;
+    }
+    stats_add(f, STAGE_EMIT, start);
+    edge_cache_roll(&slab->edges, layers);
+  }
+  return 1;
+}
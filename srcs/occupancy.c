@@ -0,0 +1,112 @@
+#include "morphosis.h"
+
+// Packed occupancy: the binary sampler only ever says inside or outside, so
+// the lattice keeps one bit per node instead of a float. Each row of nodes
+// along x is packed into 64-bit words, bit x & 63 of word x >> 6, and rows
+// follow each other in y then z like the float lattice. Nodes are still
+// sampled a plane at a time into a float scratch plane per slab, then
+// packed.
+
+int lattice_packed(t_fract *f) {
+  return f->packed && !f->distance && !f->stream && !lattice_adaptive(f) &&
+         !f->follow;
+}
+
+// Words per row of nodes, with room for bit cells.x + 1 to read as 0
+size_t occupancy_words(t_fract *f) { return (f->cells.x + 1) / 64 + 1; }
+
+static void pack_plane(t_fract *f, const float *val, uint64_t *bits) {
+  size_t words = occupancy_words(f);
+  uint64_t word;
+  uint n;
+
+  for (uint y = 0; y <= f->cells.y; y++, val += f->cells.x + 1) {
+    for (size_t w = 0; w < words; w++) {
+      word = 0;
+      n = f->cells.x + 1 - (uint)(w * 64) < 64 ? f->cells.x + 1 - (uint)(w * 64)
+                                                : 64;
+      for (uint b = 0; b < n; b++)
+        word |= (uint64_t)(val[w * 64 + b] > 0.0f) << b;
+      *bits++ = word;
+    }
+  }
+}
+
+// Each slab samples and packs the planes of its own layers, the last slab
+// the top plane as well, in its own scratch plane of vertexval
+void pack_lattice(t_data *data, t_sampler sampler, t_slab *slabs, uint n) {
+  t_fract *f = data->fract;
+  size_t plane = occupancy_words(f) * (f->cells.y + 1);
+
+  free(data->occupied);
+  if (!(data->occupied = (uint64_t *)malloc(plane * (f->cells.z + 1) *
+                                            sizeof(uint64_t))))
+    error(MALLOC_FAIL_ERR, data);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static, 1) num_threads(n)
+#endif
+  for (uint c = 0; c < n; c++) {
+    float *val = data->vertexval + c * lattice_plane(f);
+
+    for (uint z = slabs[c].z0; z < slabs[c].z1 + (c + 1 == n); z++) {
+      sample_plane(f, sampler, z, val);
+      pack_plane(f, val, data->occupied + z * plane);
+    }
+    slabs[c].bits = data->occupied;
+  }
+}
+
+static uint node_bit(const uint64_t *row, uint x) {
+  return (uint)(row[x >> 6] >> (x & 63)) & 1;
+}
+
+// classify_row for row y of layer z, 64 cells at a time: a cell is uniform
+// when its four node rows all agree at both x and x + 1, which the AND and
+// the OR of the rows tell for a whole word. Only crossed cells get their
+// cube index built from the bits, the others read 0.
+uint classify_packed_row(t_fract *f, const uint64_t *bits, uint y, uint z,
+                         uchar *cube, uint *active) {
+  size_t words = occupancy_words(f);
+  const uint64_t *rows[4];
+  uint64_t all[2];
+  uint64_t any[2];
+  uint64_t crossed;
+  uint count;
+  uint x;
+  int left;
+
+  for (int k = 0; k < 4; k++)
+    rows[k] = bits +
+              ((size_t)(z + (k >> 1)) * (f->cells.y + 1) + y + (k & 1)) * words;
+  memset(cube, 0, f->cells.x);
+  count = 0;
+  for (size_t w = 0; w < words; w++) {
+    for (int i = 0; i < 2; i++) {
+      all[i] = ~(uint64_t)0;
+      any[i] = 0;
+      for (int k = 0; w + i < words && k < 4; k++) {
+        all[i] &= rows[k][w + i];
+        any[i] |= rows[k][w + i];
+      }
+    }
+    if (w + 1 == words)
+      all[1] = 0;
+    crossed = (any[0] | (any[0] >> 1 | any[1] << 63)) &
+              ~(all[0] & (all[0] >> 1 | all[1] << 63));
+    left = (int)f->cells.x - (int)(w * 64);
+    if (left <= 0)
+      break;
+    if (left < 64)
+      crossed &= ((uint64_t)1 << left) - 1;
+    while (crossed) {
+      x = (uint)(w * 64) + (uint)__builtin_ctzll(crossed);
+      crossed &= crossed - 1;
+      for (int c = 0; c < 8; c++)
+        cube[x] |= (uchar)(node_bit(rows[f->voxel[c].dy + 2 * f->voxel[c].dz],
+                                    x + f->voxel[c].dx)
+                           << c);
+      active[count++] = x;
+    }
+  }
+  return count;
+}
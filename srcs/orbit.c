@@ -0,0 +1,121 @@
+#include "morphosis.h"
+
+// Incremental iteration: the lattice keeps each node's escape iteration and,
+// while it is still bounded, its last z. When only max_iter changes a higher
+// count continues the bounded nodes from where they stopped and a lower one
+// is answered from the stored escape iterations without iterating at all.
+
+void orbit_init(t_orbit *orbit) { memset(orbit, 0, sizeof(t_orbit)); }
+
+void orbit_free(t_orbit *orbit) {
+  free(orbit->z[0]);
+  free(orbit->escape);
+  orbit_init(orbit);
+}
+
+static void orbit_key(t_fract *f, t_orbit_key *key) {
+  memset(key, 0, sizeof(t_orbit_key));
+  key->p0[0] = f->grid.x[0];
+  key->p0[1] = f->grid.y[0];
+  key->p0[2] = f->grid.z[0];
+  key->step = f->step_size;
+  key->cells[0] = f->cells.x;
+  key->cells[1] = f->cells.y;
+  key->cells[2] = f->cells.z;
+  key->c[0] = f->julia->c.x;
+  key->c[1] = f->julia->c.y;
+  key->c[2] = f->julia->c.z;
+  key->c[3] = f->julia->c.w;
+  key->w = f->julia->w;
+  key->threshold = f->julia->threshold;
+  key->exponent = f->julia->exponent;
+}
+
+// Starts every node over at its own position, nothing iterated yet
+static int orbit_reset(t_orbit *orbit, t_fract *f, t_orbit_key *key) {
+  size_t nodes = lattice_nodes(f);
+  size_t plane = lattice_plane(f);
+  size_t row = f->cells.x + 1;
+  size_t i;
+
+  if (nodes != orbit->nodes || !orbit->escape) {
+    orbit_free(orbit);
+    if (!(orbit->z[0] = (float *)malloc(nodes * 4 * sizeof(float))) ||
+        !(orbit->escape = (uint *)malloc(nodes * sizeof(uint)))) {
+      orbit_free(orbit);
+      return 0;
+    }
+    for (int k = 1; k < 4; k++)
+      orbit->z[k] = orbit->z[k - 1] + nodes;
+    orbit->nodes = nodes;
+  }
+  for (uint z = 0; z <= f->cells.z; z++) {
+    for (uint y = 0; y <= f->cells.y; y++) {
+      i = z * plane + y * row;
+      memcpy(orbit->z[0] + i, f->grid.x, row * sizeof(float));
+      for (size_t x = 0; x < row; x++) {
+        orbit->z[1][i + x] = f->grid.y[y];
+        orbit->z[2][i + x] = f->grid.z[z];
+        orbit->z[3][i + x] = f->julia->w;
+      }
+    }
+  }
+  memset(orbit->escape, 0, nodes * sizeof(uint));
+  orbit->iters = 0;
+  orbit->key = *key;
+  return 1;
+}
+
+// Samples the whole lattice through the stored orbits. Only the Julia
+// sampler can be continued, and streaming never holds the whole lattice, so
+// both return 0 for the caller to sample the usual way, as do interval
+// culling, which samples only undecided nodes, and a lattice too large to
+// keep five extra values per node for. Orbits are only kept when asked for
+// (f->orbits, set by the GUI), since a single build never changes max_iter.
+int orbit_sample(t_data *data, t_sampler sampler) {
+  t_fract *f = data->fract;
+  t_orbit *orbit = &data->orbit;
+  t_orbit_key key;
+  size_t plane = lattice_plane(f);
+  size_t row = f->cells.x + 1;
+  uint max_iter;
+
+  if (!f->orbits || sampler != sample_4D_Julia_row || f->stream ||
+      f->culled.state || lattice_nodes(f) > ORBIT_MAX_NODES) {
+    orbit_free(orbit);
+    return 0;
+  }
+  max_iter = f->julia->max_iter;
+  orbit_key(f, &key);
+  if (!orbit->escape || memcmp(&key, &orbit->key, sizeof(t_orbit_key)))
+    if (!orbit_reset(orbit, f, &key))
+      error(MALLOC_FAIL_ERR, data);
+  if (max_iter > orbit->iters) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(lattice_threads(f))
+#endif
+    for (uint z = 0; z <= f->cells.z; z++) {
+      for (uint y = 0; y <= f->cells.y && !generation_cancelled(f); y++) {
+        size_t i = z * plane + y * row;
+        float *zs[4] = {orbit->z[0] + i, orbit->z[1] + i, orbit->z[2] + i,
+                        orbit->z[3] + i};
+        double start = stats_clock(f);
+
+        orbit_row(f->julia, zs, orbit->escape + i, (uint)row, orbit->iters,
+                  max_iter);
+        stats_add(f, STAGE_SAMPLE, start);
+        stats_evals(f, row);
+      }
+    }
+    orbit->iters = max_iter;
+  }
+  // Rows left behind would continue from the wrong iteration next time
+  if (generation_cancelled(f)) {
+    orbit_free(orbit);
+    return 1;
+  }
+  for (size_t i = 0; i < orbit->nodes; i++)
+    data->vertexval[i] =
+        !orbit->escape[i] || orbit->escape[i] > max_iter ? 1.0f : 0.0f;
+  return 1;
+}
@@ -5,41 +5,85 @@ void 						calculate_point_cloud(t_data *data)
 	t_fract 				*fract;
 
 	fract = data->fract;
-	fract->grid_size = fract->grid_length / fract->step_size;
+	stats_start(fract, data);
+	define_lattice(fract);
 	init_grid(data);
-	init_vertex(data);
 	create_grid(data);
-	define_voxel(fract, fract->step_size);
+	fit_lattice(data);
+	init_vertex(data);
+	define_voxel(fract);
 
 	build_fractal(data);
+	stats_finish(fract, data);
+}
+
+static uint					axis_cells(float start, float stop, float step)
+{
+	uint					cells;
+
+	cells = (uint)((stop - start) / step + 0.5f);
+	return (cells ? cells : 1);
 }
 
+void						define_lattice(t_fract *fract)
+{
+	fract->cells.x = axis_cells(fract->p0.x, fract->p1.x, fract->step_size);
+	fract->cells.y = axis_cells(fract->p0.y, fract->p1.y, fract->step_size);
+	fract->cells.z = axis_cells(fract->p0.z, fract->p1.z, fract->step_size);
+	fract->grid_size = (float)fract->cells.x;
+}
+
+/*
+** Lattice nodes are the grid points themselves. The original generator
+** sampled each cell's corners half a step either side of a grid point, so
+** its lattice reached half a cell outside the box. Sampling every node once
+** needs a single set of node coordinates, and putting them on the grid
+** points keeps the lattice inside the bounds asked for. Meshes therefore
+** sit half a step from where that generator put them.
+*/
+
 void						create_grid(t_data *data)
 {
-	subdiv_grid(data->fract->p0.x, data->fract->p1.x, data->fract->step_size, data->fract->grid.x);
-	subdiv_grid(data->fract->p0.y, data->fract->p1.y, data->fract->step_size, data->fract->grid.y);
-	subdiv_grid(data->fract->p0.z, data->fract->p1.z, data->fract->step_size, data->fract->grid.z);
+	t_fract 				*f;
+
+	f = data->fract;
+	subdiv_grid(f, f->p0.x, f->p1.x, f->cells.x + 1, f->grid.x);
+	subdiv_grid(f, f->p0.y, f->p1.y, f->cells.y + 1, f->grid.y);
+	subdiv_grid(f, f->p0.z, f->p1.z, f->cells.z + 1, f->grid.z);
 }
 
-void 						subdiv_grid(float start, float stop, float step, float *axis)
+/*
+** Node coordinates are derived from their integer index rather than by
+** accumulating the step, so the last node does not drift on fine grids.
+** With --symmetry they are counted in half steps out from the centre of the
+** box instead, so a box centred on 0 gets nodes that mirror exactly, as
+** symmetry.c needs; that moves the lattice by the part of a step lost
+** rounding the box to whole cells.
+*/
+
+void 						subdiv_grid(t_fract *f, float start, float stop,
+								uint count, float *axis)
 {
-	float 					val;
-	int						i;
+	float					centre;
 
-	val = start;
-	i = 0;
-	while (val <= stop)
+	if (!f->symmetry)
 	{
-		axis[i++] = val;
-		val += step;
+		for (uint i = 0; i < count; i++)
+			axis[i] = start + (float)i * f->step_size;
+		return ;
 	}
+	centre = 0.5f * (start + stop);
+	for (uint i = 0; i < count; i++)
+		axis[i] = centre + (float)(int)(2 * i - (count - 1))
+			* (0.5f * f->step_size);
 }
 
-void						define_voxel(t_fract *fract, float s)
+void						define_voxel(t_fract *fract)
 {
-	const float 			zz[2] = {-s / 2, s / 2};
-	const float 			xx[4] = {-s / 2, s / 2, s / 2, -s / 2};
-	const float 			yy[4] = {s / 2, s / 2, -s / 2, -s / 2};
+	const uint 				zz[2] = {0, 1};
+	const uint 				xx[4] = {0, 1, 1, 0};
+	const uint 				yy[4] = {1, 1, 0, 0};
+	const size_t			row = fract->cells.x + 1;
 	unsigned 				n = 0;
 
 	for (unsigned i = 0; i < 2; i++)
@@ -49,6 +93,7 @@ void						define_voxel(t_fract *fract, float s)
 			fract->voxel[n].dx = xx[j];
 			fract->voxel[n].dy = yy[j];
 			fract->voxel[n].dz = zz[i];
+			fract->voxel[n].offset = xx[j] + yy[j] * row;
 			n++;
 		}
 	}
@@ -1,27 +1,20 @@
 #include "morphosis.h"
 
 // Optimized version of calculate_point_cloud that uses the optimized
-// build_fractal
+// build_fractal. Like calculate_point_cloud it leaves the mesh in data for
+// the caller to copy out with gl_retrieve_tris.
 void calculate_point_cloud_optimized(t_data *data) {
   t_fract *fract = data->fract;
 
-  printf("Initializing OPTIMIZED point cloud generation...\n");
-
-  fract->grid_size = fract->grid_length / fract->step_size;
+  stats_start(fract, data);
+  define_lattice(fract);
   init_grid(data);
-  init_vertex(data);
   create_grid(data);
-  define_voxel(fract, fract->step_size);
+  fit_lattice(data);
+  init_vertex(data);
+  define_voxel(fract);
 
   // Use the optimized fractal building function
   build_fractal_optimized(data);
-  
-  // Retrieve triangles for OpenGL (same as original)
-  gl_retrieve_tris(data);
-  
-  // Clean up calculations (same as original)
-  clean_calcs(data);
-
-  printf("OPTIMIZED point cloud generation complete!\n");
-  printf("Total triangles generated: %d\n", data->gl->num_tris);
+  stats_finish(fract, data);
 }
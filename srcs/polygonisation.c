@@ -1,139 +1,325 @@
 #include "look-up.h"
 #include "morphosis.h"
 
-static uint getCubeIndex(float *v_val, uint pos) {
+static uint getCubeIndex(float *v_val) {
   uint cubeindex;
 
   cubeindex = 0;
-  if (v_val[pos + 0])
+  if (v_val[0] > 0.0f)
     cubeindex |= 1;
-  if (v_val[pos + 1])
+  if (v_val[1] > 0.0f)
     cubeindex |= 2;
-  if (v_val[pos + 2])
+  if (v_val[2] > 0.0f)
     cubeindex |= 4;
-  if (v_val[pos + 3])
+  if (v_val[3] > 0.0f)
     cubeindex |= 8;
-  if (v_val[pos + 4])
+  if (v_val[4] > 0.0f)
     cubeindex |= 16;
-  if (v_val[pos + 5])
+  if (v_val[5] > 0.0f)
     cubeindex |= 32;
-  if (v_val[pos + 6])
+  if (v_val[6] > 0.0f)
     cubeindex |= 64;
-  if (v_val[pos + 7])
+  if (v_val[7] > 0.0f)
     cubeindex |= 128;
   return cubeindex;
 }
 
+// Vertex on a crossing edge. An outside node carrying a distance estimate
+// puts it that far towards the inside node, scaled by EDGE_OBLIQUITY since
+// the estimate runs along the surface normal and edges seldom do; a plain 0
+// from the binary sampler knows nothing better than the inside node itself.
+//
+// An edge at angle t to the normal is 1 / cos t times longer to the surface
+// than the estimate. Over surfaces of every orientation, an edge is crossed
+// in proportion to cos t, which leaves cos t with density 2 cos t: 1 / cos t
+// then has a median of sqrt(2) and a mean of 2. The mean is pulled up by
+// edges almost parallel to the surface, where the clamp to the inside node
+// takes over, so EDGE_OBLIQUITY sits between the two at 1.5.
 static float3 interpolate(float3 p0, float3 p1, float v0, float v1) {
-  float mu;
-  float3 p;
-
-  if (v0 == 1.0f)
-    return p0;
-  if (v1 == 1.0f)
-    return p1;
-  if ((v1 - v0) == 0.0f)
-    return p0;
-  mu = (1.0f - v0) / (v1 - v0);
+  float3 in;
+  float3 out;
+  float d;
+  float len;
+
+  in = v0 > 0.0f ? p0 : p1;
+  out = v0 > 0.0f ? p1 : p0;
+  d = (v0 > 0.0f ? -v1 : -v0) * EDGE_OBLIQUITY;
+  if (d <= 0.0f)
+    return in;
+  len = sqrtf((in.x - out.x) * (in.x - out.x) +
+              (in.y - out.y) * (in.y - out.y) +
+              (in.z - out.z) * (in.z - out.z));
+  if (d >= len)
+    return in;
 #ifdef __APPLE__
-  p = p0 + mu * (p1 - p0);
+  return out + (d / len) * (in - out);
 #else
-  p = VEC3_INTERPOLATE(p0, mu, p1);
+  return VEC3_INTERPOLATE(out, d / len, in);
 #endif
-  return p;
 }
 
-static float3 *get_vertices(uint cubeindex, float3 *v_pos, float *v_val,
-                            uint pos) {
-  float3 *vertlist;
-
-  if (!(vertlist = (float3 *)malloc(12 * sizeof(float3))))
-    return NULL;
-
-  if (edgetable[cubeindex] & 1)
-    vertlist[0] = interpolate(v_pos[pos + 0], v_pos[pos + 1], v_val[pos + 0],
-                              v_val[pos + 1]);
-  if (edgetable[cubeindex] & 2)
-    vertlist[1] = interpolate(v_pos[pos + 1], v_pos[pos + 2], v_val[pos + 1],
-                              v_val[pos + 2]);
-  if (edgetable[cubeindex] & 4)
-    vertlist[2] = interpolate(v_pos[pos + 2], v_pos[pos + 3], v_val[pos + 2],
-                              v_val[pos + 3]);
-  if (edgetable[cubeindex] & 8)
-    vertlist[3] = interpolate(v_pos[pos + 3], v_pos[pos + 0], v_val[pos + 3],
-                              v_val[pos + 0]);
-  if (edgetable[cubeindex] & 16)
-    vertlist[4] = interpolate(v_pos[pos + 4], v_pos[pos + 5], v_val[pos + 4],
-                              v_val[pos + 5]);
-  if (edgetable[cubeindex] & 32)
-    vertlist[5] = interpolate(v_pos[pos + 5], v_pos[pos + 6], v_val[pos + 5],
-                              v_val[pos + 6]);
-  if (edgetable[cubeindex] & 64)
-    vertlist[6] = interpolate(v_pos[pos + 6], v_pos[pos + 7], v_val[pos + 6],
-                              v_val[pos + 7]);
-  if (edgetable[cubeindex] & 128)
-    vertlist[7] = interpolate(v_pos[pos + 7], v_pos[pos + 4], v_val[pos + 7],
-                              v_val[pos + 4]);
-  if (edgetable[cubeindex] & 256)
-    vertlist[8] = interpolate(v_pos[pos + 0], v_pos[pos + 4], v_val[pos + 0],
-                              v_val[pos + 4]);
-  if (edgetable[cubeindex] & 512)
-    vertlist[9] = interpolate(v_pos[pos + 1], v_pos[pos + 5], v_val[pos + 1],
-                              v_val[pos + 5]);
-  if (edgetable[cubeindex] & 1024)
-    vertlist[10] = interpolate(v_pos[pos + 2], v_pos[pos + 6], v_val[pos + 2],
-                               v_val[pos + 6]);
-  if (edgetable[cubeindex] & 2048)
-    vertlist[11] = interpolate(v_pos[pos + 3], v_pos[pos + 7], v_val[pos + 3],
-                               v_val[pos + 7]);
-  return vertlist;
+// Corners joined by each cube edge, lower lattice node first, so a shared
+// edge is interpolated the same way whichever cell creates its vertex.
+static const uchar edge_corners[12][2] = {{0, 1}, {2, 1}, {3, 2}, {3, 0},
+                                          {4, 5}, {6, 5}, {7, 6}, {7, 4},
+                                          {0, 4}, {1, 5}, {2, 6}, {3, 7}};
+
+// Where each cube edge lives in the edge cache: axis (0 x, 1 y, 2 z), the
+// plane it lies in for x/y edges, and the unit offset of its lower node.
+static const uchar edge_slot[12][4] = {
+    {0, 0, 0, 1}, {1, 0, 1, 0}, {0, 0, 0, 0}, {1, 0, 0, 0},
+    {0, 1, 0, 1}, {1, 1, 1, 0}, {0, 1, 0, 0}, {1, 1, 0, 0},
+    {2, 0, 0, 1}, {2, 0, 1, 1}, {2, 0, 1, 0}, {2, 0, 0, 0}};
+
+int edge_cache_init(t_edges *edges, size_t plane, uint depth) {
+  size_t run = plane * depth;
+
+  edges->plane = plane;
+  edges->depth = depth;
+  edges->layer = 0;
+  edges->x[0] = (uint *)malloc(plane * sizeof(uint));
+  edges->x[1] = (uint *)malloc(run * sizeof(uint));
+  edges->y[0] = (uint *)malloc(plane * sizeof(uint));
+  edges->y[1] = (uint *)malloc(run * sizeof(uint));
+  edges->z = (uint *)malloc(run * sizeof(uint));
+  if (!edges->x[0] || !edges->x[1] || !edges->y[0] || !edges->y[1] ||
+      !edges->z) {
+    edge_cache_free(edges);
+    return 0;
+  }
+  memset(edges->x[0], 0xff, plane * sizeof(uint));
+  memset(edges->x[1], 0xff, run * sizeof(uint));
+  memset(edges->y[0], 0xff, plane * sizeof(uint));
+  memset(edges->y[1], 0xff, run * sizeof(uint));
+  memset(edges->z, 0xff, run * sizeof(uint));
+  return 1;
 }
 
-static float3 **package_triangles(float3 *vertlist, uint cubeindex, uint i,
-                                  t_data *data) {
-  uint2 len;
-  float3 **tris_new;
-
-  len.x = 0;
-  len.y = 1;
-  tris_new = NULL;
-  if (!(tris_new = alloc_float3_arr(tris_new, &len)))
-    error(MALLOC_FAIL_ERR, data);
-
-  tris_new[0][0] = vertlist[tritable[cubeindex][i]];
-  tris_new[0][1] = vertlist[tritable[cubeindex][i + 1]];
-  tris_new[0][2] = vertlist[tritable[cubeindex][i + 2]];
-  return tris_new;
+// Moves past the first layers of the run: the x/y edges of the upper plane
+// of the last of them become the lowest plane's, everything else starts
+// empty. A run of one layer swaps its two planes instead of copying.
+void edge_cache_roll(t_edges *edges, uint layers) {
+  size_t top = (size_t)(layers - 1) * edges->plane;
+  size_t run = (size_t)layers * edges->plane;
+  uint *tmp;
+
+  if (edges->depth == 1) {
+    tmp = edges->x[0];
+    edges->x[0] = edges->x[1];
+    edges->x[1] = tmp;
+    tmp = edges->y[0];
+    edges->y[0] = edges->y[1];
+    edges->y[1] = tmp;
+  } else {
+    memcpy(edges->x[0], edges->x[1] + top, edges->plane * sizeof(uint));
+    memcpy(edges->y[0], edges->y[1] + top, edges->plane * sizeof(uint));
+  }
+  memset(edges->x[1], 0xff, run * sizeof(uint));
+  memset(edges->y[1], 0xff, run * sizeof(uint));
+  memset(edges->z, 0xff, run * sizeof(uint));
+  edges->layer = 0;
 }
 
-float3 **polygonise(float3 *v_pos, float *v_val, uint2 *pos, t_data *data) {
-  float3 **tris;
-  float3 **tris_new;
-  float3 *vertlist;
-  uint cubeindex;
-  uint i;
-  uint2 len;
-
-  tris = NULL;
-  tris_new = NULL;
-  vertlist = NULL;
-  i = 0;
-  len.x = 0;
-  cubeindex = getCubeIndex(v_val, pos->x);
-  if (edgetable[cubeindex] == 0)
-    return NULL;
-  if (!(vertlist = get_vertices(cubeindex, v_pos, v_val, pos->x)))
-    error(MALLOC_FAIL_ERR, data);
-
-  while ((int)tritable[cubeindex][i] != -1) {
-    tris_new = package_triangles(vertlist, cubeindex, i, data);
-    len.y = 1;
-    if (!(tris = arr_float3_cat(tris_new, tris, &len)))
-      error(MALLOC_FAIL_ERR, data);
-    i += 3;
+void edge_cache_free(t_edges *edges) {
+  free(edges->x[0]);
+  free(edges->x[1]);
+  free(edges->y[0]);
+  free(edges->y[1]);
+  free(edges->z);
+  edges->x[0] = edges->x[1] = NULL;
+  edges->y[0] = edges->y[1] = NULL;
+  edges->z = NULL;
+}
+
+// Marching cubes for a cell of known cube index, see polygonise_cell
+static uint polygonise_cube(uint cube, float3 *c_pos, float *c_val,
+                            uint **slots, t_mesh *mesh, uint *out) {
+  unsigned long long tris;
+  uint edges;
+  uint a;
+  uint b;
+
+  if (!(edges = edgetable[cube]))
+    return 0;
+  for (uint e = 0; e < 12; e++) {
+    if (!(edges & (1u << e)) || *slots[e] != EDGE_NONE)
+      continue;
+    a = edge_corners[e][0];
+    b = edge_corners[e][1];
+    if (mesh->keep_ends) {
+      mesh->verts[mesh->num_verts] = c_val[a] > 0.0f ? c_pos[a] : c_pos[b];
+      mesh->ends[mesh->num_verts] = c_val[a] > 0.0f ? c_pos[b] : c_pos[a];
+    } else
+      mesh->verts[mesh->num_verts] =
+          interpolate(c_pos[a], c_pos[b], c_val[a], c_val[b]);
+    *slots[e] = mesh->num_verts++;
+  }
+  tris = tritable[cube];
+  for (uint i = 0; i < (uint)(tris >> 60) * 3; i++)
+    *out++ = *slots[tris >> (4 * i) & 15];
+  return (uint)(tris >> 60);
+}
+
+// Marching cubes for a single cell. slots[e] is the cache entry of cube edge
+// e: a crossing edge reuses the vertex stored there or appends a new one to
+// mesh. Triangles are written to out as index triples. The caller reserves
+// room for 12 vertices, and out must hold MC_MAX_TRIS triangles. A mesh
+// keeping edge ends gets the inside node now and is refined afterwards.
+uint polygonise_cell(float3 *c_pos, float *c_val, uint **slots, t_mesh *mesh,
+                     uint *out) {
+  return polygonise_cube(getCubeIndex(c_val), c_pos, c_val, slots, mesh, out);
+}
+
+// Lattice faces x = 0 (bit 0), y = 0 and z = 0 holding cube edge e of cell
+static uchar edge_faces(uint3 cell, uint e) {
+  uint node[3] = {cell.x + edge_slot[e][2], cell.y + edge_slot[e][3],
+                  cell.z + edge_slot[e][1]};
+  uchar faces = 0;
+
+  for (uint a = 0; a < 3; a++)
+    if (a != edge_slot[e][0] && !node[a])
+      faces |= (uchar)(1u << a);
+  return faces;
+}
+
+// Appends the triangles of one lattice cell, whose cube index is already
+// known, to the slab's mesh, welding vertices on edges already visited
+// through the slab's edge cache. The caller reserves 12 vertices and
+// MC_MAX_TRIS triangles per cell beforehand, so nothing here touches the heap.
+// Packed occupancy keeps no samples: its nodes read 1 inside and 0 outside,
+// exactly what the binary sampler gives.
+uint polygonise(t_fract *f, t_slab *slab, uint3 cell, uint cube) {
+  t_mesh *mesh;
+  t_edges *edges;
+  float3 c_pos[8];
+  float c_val[8];
+  uint *slots[12];
+  uint *axis[2][3];
+  size_t base;
+  size_t row;
+  size_t lift;
+  uint first;
+  uint n;
+
+  mesh = slab->mesh;
+  edges = &slab->edges;
+  if (edgetable[cube] == 0)
+    return 0;
+  base = lattice_index(f, cell.x, cell.y);
+  for (int c = 0; c < 8; c++) {
+    c_val[c] = slab->bits
+                   ? (float)(cube >> c & 1)
+                   : slab->planes[f->voxel[c].dz][base + f->voxel[c].offset];
+    c_pos[c].x = f->grid.x[cell.x + f->voxel[c].dx];
+    c_pos[c].y = f->grid.y[cell.y + f->voxel[c].dy];
+    c_pos[c].z = f->grid.z[cell.z + f->voxel[c].dz];
   }
-  data->len.y = len.x;
+  row = f->cells.x + 1;
+  lift = edges->layer * edges->plane;
+  axis[0][0] = edges->layer ? edges->x[1] + lift - edges->plane : edges->x[0];
+  axis[0][1] = edges->layer ? edges->y[1] + lift - edges->plane : edges->y[0];
+  axis[1][0] = edges->x[1] + lift;
+  axis[1][1] = edges->y[1] + lift;
+  axis[0][2] = axis[1][2] = edges->z + lift;
+  for (int e = 0; e < 12; e++)
+    slots[e] = axis[edge_slot[e][1]][edge_slot[e][0]] + base + edge_slot[e][2] +
+               edge_slot[e][3] * row;
+  first = mesh->num_verts;
+  n = polygonise_cube(cube, c_pos, c_val, slots, mesh,
+                      mesh->idx + (size_t)mesh->num_tris * 3);
+  mesh->num_tris += n;
+  if (mesh->keep_faces)
+    for (uint e = 0; e < 12; e++)
+      if (*slots[e] >= first && *slots[e] < mesh->num_verts)
+        mesh->faces[*slots[e]] = edge_faces(cell, e);
+  return n;
+}
+
+// Cube edges on each face of a cell: -x, +x, -y, +y, -z, +z
+static const uint face_edges[6] = {0x988, 0x622, 0xc44, 0x311, 0x00f, 0x0f0};
+
+// Faces of a cell the surface crosses, bit f for face_edges[f], so the
+// surface continues into the neighbouring cell across each of them
+uint cube_faces(uint cube) {
+  uint faces;
+
+  faces = 0;
+  for (uint f = 0; f < 6; f++)
+    if (edgetable[cube] & face_edges[f])
+      faces |= 1u << f;
+  return faces;
+}
+
+// Classifies a whole row of cells with the dispatched kernel first, which
+// lists the cells the surface crosses, so only those are triangulated.
+// Packed occupancy classifies from its bits instead.
+void polygonise_row(t_fract *f, t_slab *slab, uint y, uint z) {
+  double start = stats_clock(f);
+  size_t base;
+  uint3 cell;
+  uint n;
 
-  free(vertlist);
-  return tris;
+  base = lattice_index(f, 0, y);
+  if (slab->bits)
+    n = classify_packed_row(f, slab->bits, y, z, slab->cubes, slab->active);
+  else
+    n = classify_row(slab->planes[0] + base, slab->planes[1] + base,
+                     f->cells.x + 1, f->cells.x, slab->cubes, slab->active);
+  start = stats_add(f, STAGE_CLASSIFY, start);
+  cell.y = y;
+  cell.z = z;
+  for (uint i = 0; i < n; i++) {
+    cell.x = slab->active[i];
+    polygonise(f, slab, cell, slab->cubes[cell.x]);
+  }
+  stats_add(f, STAGE_EMIT, start);
+}
+
+static void midpoints(const float3 *in, const float3 *out, uint n, float *x,
+                      float *y, float *z) {
+  for (uint k = 0; k < n; k++) {
+    x[k] = 0.5f * (in[k].x + out[k].x);
+    y[k] = 0.5f * (in[k].y + out[k].y);
+    z[k] = 0.5f * (in[k].z + out[k].z);
+  }
+}
+
+// Edge bisection: every vertex still sits on the inside node of its edge,
+// with the outside node in ends. Each step samples the midpoints of a batch
+// of edges in one kernel call and keeps the half the surface crosses; the
+// vertex ends at the middle of the last bracket, within 2^-(steps + 1) of an
+// edge length from a crossing.
+void refine_vertices(t_julia *julia, t_mesh *mesh, uint steps) {
+  float x[REFINE_BATCH];
+  float y[REFINE_BATCH];
+  float z[REFINE_BATCH];
+  float inside[REFINE_BATCH];
+  float3 *in;
+  float3 *out;
+  float3 *half;
+  uint len;
+
+  for (uint i = 0; i < mesh->num_verts; i += len) {
+    len = mesh->num_verts - i < REFINE_BATCH ? mesh->num_verts - i
+                                             : REFINE_BATCH;
+    in = mesh->verts + i;
+    out = mesh->ends + i;
+    for (uint s = 0; s < steps; s++) {
+      midpoints(in, out, len, x, y, z);
+      sample_4D_Julia_points(julia, x, y, z, len, inside);
+      for (uint k = 0; k < len; k++) {
+        half = inside[k] > 0.0f ? in + k : out + k;
+        half->x = x[k];
+        half->y = y[k];
+        half->z = z[k];
+      }
+    }
+    midpoints(in, out, len, x, y, z);
+    for (uint k = 0; k < len; k++) {
+      in[k].x = x[k];
+      in[k].y = y[k];
+      in[k].z = z[k];
+    }
+  }
+  mesh->keep_ends = 0;
 }
@@ -1,25 +1,93 @@
 #include "morphosis.h"
+#include <float.h>
+
+/*
+** Scalar reference for the batched kernels in kernels.inc: z runs through
+** z^exponent + c until |z|^2 passes threshold^2. The power is a closed-form
+** square followed by plain products, in the same order as the kernels.
+*/
 
 float 						sample_4D_Julia(t_julia *julia, float3 pos)
 {
 	cl_quat 				z;
+	cl_quat 				p;
 	uint 					iter;
-	float					temp_mod;
+	float					escape2;
 
 	iter = 0;
 	z.x = pos.x;
 	z.y = pos.y;
 	z.z = pos.z;
 	z.w = julia->w;
-
+	escape2 = julia->threshold * julia->threshold;
 	while (iter < julia->max_iter)
 	{
-		z = cl_quat_mult(z, z);
-		z = cl_quat_sum(z, julia->c);
-		temp_mod = cl_quat_mod(z);
-		if (temp_mod > 2.0f)
+		p = cl_quat_square(z);
+		for (uint k = 2; k < julia->exponent; k++)
+			p = cl_quat_mult(p, z);
+		z = cl_quat_sum(p, julia->c);
+		if (cl_quat_mod2(z) > escape2)
 			return 0.0f;
 		iter++;
 	}
 	return 1.0f;
 }
+
+/*
+** Distance from a node that escaped at iteration iter to the surface meshed,
+** where |z| reaches threshold exactly at max_iter: the potential
+** ln|z| - exponent^(iter - max_iter) ln(threshold) over its gradient
+** |dz| / |z|. It never reaches 0 so an outside node stays distinct from the
+** binary sampler's plain 0, which carries no distance.
+*/
+
+float						julia_distance(t_julia *julia, float mod2, float dr2,
+							uint iter)
+{
+	float					de;
+	float					g;
+
+	g = logf(julia->threshold);
+	while (iter++ < julia->max_iter)
+		g /= (float)julia->exponent;
+	de = sqrtf(mod2 / dr2) * (0.5f * logf(mod2) - g);
+	return de > FLT_MIN ? de : FLT_MIN;
+}
+
+/*
+** Distance field reference for the kernels' distance_row: 1 inside the set,
+** otherwise minus the estimated distance to its surface, from the running
+** derivative |dz|^2 -> exponent^2 |z|^(2 exponent - 2) |dz|^2.
+*/
+
+float						sample_4D_Julia_distance(t_julia *julia,
+							float3 pos)
+{
+	cl_quat					z;
+	cl_quat					p;
+	float					mod2;
+	float					dr2;
+	float					f;
+
+	z.x = pos.x;
+	z.y = pos.y;
+	z.z = pos.z;
+	z.w = julia->w;
+	mod2 = cl_quat_mod2(z);
+	dr2 = 1.0f;
+	for (uint iter = 0; iter < julia->max_iter; iter++)
+	{
+		f = mod2;
+		for (uint k = 2; k < julia->exponent; k++)
+			f = f * mod2;
+		dr2 = dr2 * ((float)(julia->exponent * julia->exponent) * f);
+		p = cl_quat_square(z);
+		for (uint k = 2; k < julia->exponent; k++)
+			p = cl_quat_mult(p, z);
+		z = cl_quat_sum(p, julia->c);
+		mod2 = cl_quat_mod2(z);
+		if (mod2 > julia->threshold * julia->threshold)
+			return -julia_distance(julia, mod2, dr2, iter + 1);
+	}
+	return 1.0f;
+}
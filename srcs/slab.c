@@ -0,0 +1,144 @@
+#include "morphosis.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Parallel generation: the layers of cells are split into contiguous slabs,
+// each meshed into its own buffer with its own edge cache. Vertices on the
+// node plane between two slabs are owned by the lower one; the upper slab
+// refers to them through tagged indices that slab_merge resolves.
+
+#define EDGE_EXTERN 0x80000000u
+#define EDGE_EXTERN_Y 0x40000000u
+#define EDGE_EXTERN_POS 0x3fffffffu
+
+uint lattice_threads(t_fract *f) {
+  if (f->threads)
+    return f->threads;
+#ifdef _OPENMP
+  return (uint)omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// Whether another thread has asked for the build in progress to be dropped.
+// Stages stop at the next plane or layer and leave the mesh empty.
+int generation_cancelled(t_fract *f) {
+  return f->cancel && __atomic_load_n(f->cancel, __ATOMIC_RELAXED);
+}
+
+uint slab_count(t_fract *f) {
+  uint n;
+
+  n = lattice_threads(f);
+  if (n > morton_runs(f))
+    n = morton_runs(f);
+  // Tagged indices only have room for this many nodes per plane
+  if (!n || lattice_plane(f) >= EDGE_EXTERN_POS)
+    n = 1;
+  return n;
+}
+
+// The lower plane of every slab but the first belongs to the slab below:
+// its x and y edges are pre-filled with tags naming their position.
+static void slab_borrow_plane(t_slab *slab) {
+  for (size_t p = 0; p < slab->edges.plane; p++) {
+    slab->edges.x[0][p] = EDGE_EXTERN | (uint)p;
+    slab->edges.y[0][p] = EDGE_EXTERN | EDGE_EXTERN_Y | (uint)p;
+  }
+}
+
+// Slabs meshed in bricks start on a run of whole bricks, see morton.c
+static uint slab_start(t_fract *f, uint c, uint n) {
+  uint depth = lattice_morton(f) ? f->morton : 1;
+  uint z = (uint)((size_t)morton_runs(f) * c / n) * depth;
+
+  return z < f->cells.z ? z : f->cells.z;
+}
+
+t_slab *slab_split(t_data *data, uint n) {
+  t_fract *f = data->fract;
+  t_slab *slabs;
+  uint depth;
+  uint hint;
+
+  if (!(slabs = (t_slab *)calloc(n, sizeof(t_slab))))
+    return NULL;
+  depth = lattice_morton(f) ? f->morton : 1;
+  hint = mesh_estimate(f) / n;
+  for (uint c = 0; c < n; c++) {
+    slabs[c].z0 = slab_start(f, c, n);
+    slabs[c].z1 = slab_start(f, c + 1, n);
+    slabs[c].mesh = c ? &slabs[c].own : &data->mesh;
+    if (c)
+      mesh_init(&slabs[c].own);
+    slabs[c].mesh->keep_ends = f->refine != 0;
+    slabs[c].mesh->keep_faces = data->mesh.keep_faces;
+    if (f->stream) {
+      slabs[c].planes[0] = data->vertexval + 2 * c * lattice_plane(f);
+      slabs[c].planes[1] = slabs[c].planes[0] + lattice_plane(f);
+    }
+    if (!(slabs[c].cubes = (uchar *)malloc(
+              (size_t)f->cells.x *
+              (lattice_morton(f) ? f->cells.y * depth : 1))) ||
+        !(slabs[c].active = (uint *)malloc(f->cells.x * sizeof(uint))) ||
+        !edge_cache_init(&slabs[c].edges, lattice_plane(f), depth) ||
+        !mesh_reserve(slabs[c].mesh, hint / 2, hint)) {
+      slab_free(slabs, c + 1);
+      return NULL;
+    }
+    if (c)
+      slab_borrow_plane(slabs + c);
+  }
+  return slabs;
+}
+
+// Appends every slab to the first one's mesh in z order. After its last
+// layer a slab's edge cache holds its upper plane in x[0] and y[0], which is
+// where the tags of the slab above point.
+int slab_merge(t_slab *slabs, uint n) {
+  t_mesh *mesh = slabs[0].mesh;
+  t_mesh *own;
+  uint *hi;
+  uint prev;
+  uint base;
+  uint v;
+
+  prev = 0;
+  for (uint c = 1; c < n; c++) {
+    own = &slabs[c].own;
+    base = mesh->num_verts;
+    if (!mesh_reserve(mesh, own->num_verts, own->num_tris))
+      return 0;
+    memcpy(mesh->verts + base, own->verts, own->num_verts * sizeof(float3));
+    if (mesh->keep_faces)
+      memcpy(mesh->faces + base, own->faces, own->num_verts);
+    for (size_t i = 0; i < (size_t)own->num_tris * 3; i++) {
+      v = own->idx[i];
+      if (v & EDGE_EXTERN) {
+        hi = v & EDGE_EXTERN_Y ? slabs[c - 1].edges.y[0]
+                               : slabs[c - 1].edges.x[0];
+        v = hi[v & EDGE_EXTERN_POS] + prev;
+      } else
+        v += base;
+      mesh->idx[(size_t)mesh->num_tris * 3 + i] = v;
+    }
+    mesh->num_verts += own->num_verts;
+    mesh->num_tris += own->num_tris;
+    mesh->allocs += own->allocs;
+    prev = base;
+  }
+  return 1;
+}
+
+void slab_free(t_slab *slabs, uint n) {
+  for (uint c = 0; c < n; c++) {
+    edge_cache_free(&slabs[c].edges);
+    free(slabs[c].cubes);
+    free(slabs[c].active);
+    if (c)
+      mesh_free(&slabs[c].own);
+  }
+  free(slabs);
+}
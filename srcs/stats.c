@@ -0,0 +1,87 @@
+#include "morphosis.h"
+#include <sys/resource.h>
+#include <time.h>
+
+// Build profile: each stage adds the time it took to the build's t_stats as
+// it goes, from whichever thread runs it, so stages running on several
+// threads count every thread's share. Timing costs two clock reads per row
+// or call timed, and nothing at all when f->stats is NULL, as it is unless
+// the Performance Monitor is open or --stats was given.
+
+// Monotonic time in seconds, whether or not builds are profiled
+double stats_now(void) {
+  struct timespec t;
+
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return (double)t.tv_sec + (double)t.tv_nsec * 1e-9;
+}
+
+double stats_clock(t_fract *f) {
+  if (!f->stats)
+    return 0.0;
+  return stats_now();
+}
+
+// Adds the time since since to stage and returns the time now, which times
+// the next stage of the same thread
+double stats_add(t_fract *f, t_stage stage, double since) {
+  double now;
+
+  if (!f->stats)
+    return 0.0;
+  now = stats_clock(f);
+  __atomic_fetch_add(&f->stats->ns[stage],
+                     (unsigned long long)((now - since) * 1e9),
+                     __ATOMIC_RELAXED);
+  return now;
+}
+
+void stats_evals(t_fract *f, size_t n) {
+  if (f->stats)
+    __atomic_fetch_add(&f->stats->evals, (unsigned long long)n,
+                       __ATOMIC_RELAXED);
+}
+
+// While a build runs, seconds and allocs hold their values at its start.
+// Allocations are those of the mesh data builds into, slabs merged into it
+// included, so buffers other threads grow meanwhile are not counted.
+void stats_start(t_fract *f, t_data *data) {
+  t_stats *s = f->stats;
+  unsigned long builds;
+
+  if (!s)
+    return;
+  builds = s->builds;
+  memset(s, 0, sizeof(t_stats));
+  s->builds = builds;
+  s->seconds = stats_clock(f);
+  s->allocs = data->mesh.allocs;
+}
+
+void stats_finish(t_fract *f, t_data *data) {
+  t_stats *s = f->stats;
+
+  if (!s)
+    return;
+  s->seconds = stats_clock(f) - s->seconds;
+  s->allocs = data->mesh.allocs - s->allocs;
+  s->lattice_bytes = lattice_nodes(f) * sizeof(float);
+  if (lattice_packed(f))
+    s->lattice_bytes += occupancy_words(f) * (f->cells.y + 1) *
+                        (f->cells.z + 1) * sizeof(uint64_t);
+  s->tris = data->mesh.num_tris;
+}
+
+// Largest resident set the process has had, in bytes. Linux reports
+// ru_maxrss in kilobytes, macOS in bytes.
+size_t stats_peak_rss(void) {
+  struct rusage usage;
+
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+#ifdef __APPLE__
+  return (size_t)usage.ru_maxrss;
+#else
+  return (size_t)usage.ru_maxrss * 1024;
+#endif
+}
@@ -0,0 +1,144 @@
+#include "morphosis.h"
+
+// Symmetric sets: z -> z^p + c keeps the direction of the imaginary part of
+// z, so any reflection of the imaginary axes that fixes c maps orbits onto
+// orbits. c.y == 0 mirrors the set in y and c.z == 0 in z; with both and
+// w == 0, z -> -z lands on the same orbit after one step, which adds a
+// mirror in x.
+//
+// Mirrors are only used for z^2 + c, where mirrored nodes sample exactly
+// alike: every term of the square changes sign with the axis reflected or
+// not at all. Higher powers multiply by z again, and terms such as
+// p.w * q.y - p.y * q.w, which cancel in exact arithmetic, round
+// differently in the two mirror images.
+//
+// Only the part of the lattice on the positive side of every mirror is
+// sampled and meshed, then reflected plane by plane. Vertices on lattice
+// edges lying in a mirror plane are their own images and are shared by both
+// halves; the mesh records which those are, as a vertex on an edge crossing
+// the plane can sit on the plane too.
+
+static int axis_symmetric(const float *axis, uint cells) {
+  if (cells % 2)
+    return 0;
+  for (uint i = 0; i <= cells / 2; i++)
+    if (axis[i] != -axis[cells - i])
+      return 0;
+  return 1;
+}
+
+// Bit a set for each axis a, x = 0, the set mirrors in, whatever the lattice
+uint set_mirrors(t_fract *f, t_sampler sampler) {
+  t_julia *j = f->julia;
+  uint mirrors = 0;
+
+  if ((sampler != sample_4D_Julia_row &&
+       sampler != sample_4D_Julia_distance_row) ||
+      j->exponent != 2)
+    return 0;
+  if (j->c.y == 0.0f && j->c.z == 0.0f && j->w == 0.0f)
+    mirrors |= 1;
+  if (j->c.y == 0.0f)
+    mirrors |= 2;
+  if (j->c.z == 0.0f)
+    mirrors |= 4;
+  return mirrors;
+}
+
+// Bit a set for each axis a both the set and the lattice mirror in
+uint lattice_mirrors(t_fract *f, t_sampler sampler) {
+  uint mirrors;
+
+  if (!f->symmetry)
+    return 0;
+  mirrors = set_mirrors(f, sampler);
+  if (!axis_symmetric(f->grid.x, f->cells.x))
+    mirrors &= ~1u;
+  if (!axis_symmetric(f->grid.y, f->cells.y))
+    mirrors &= ~2u;
+  if (!axis_symmetric(f->grid.z, f->cells.z))
+    mirrors &= ~4u;
+  return mirrors;
+}
+
+// Corner offsets follow the row length of whichever lattice is meshed
+static void voxel_rows(t_fract *f) {
+  for (int c = 0; c < 8; c++)
+    f->voxel[c].offset = f->voxel[c].dx + f->voxel[c].dy * (f->cells.x + 1);
+}
+
+static float *coord(float3 *v, int a) {
+  return a == 0 ? &v->x : a == 1 ? &v->y : &v->z;
+}
+
+// Appends the reflection of the whole mesh through the plane a = 0, with
+// its triangles wound the other way to keep facing out
+static void mirror_mesh(t_data *data, t_mesh *mesh, int a) {
+  uint verts = mesh->num_verts;
+  uint tris = mesh->num_tris;
+  uint *image;
+  uint added;
+
+  if (!(image = (uint *)malloc((verts ? verts : 1) * sizeof(uint))))
+    error(MALLOC_FAIL_ERR, data);
+  added = 0;
+  for (uint i = 0; i < verts; i++)
+    image[i] = mesh->faces[i] & (1u << a) ? i : verts + added++;
+  if (!mesh_reserve(mesh, added, tris))
+    error(MALLOC_FAIL_ERR, data);
+  for (uint i = 0; i < verts; i++) {
+    if (image[i] == i)
+      continue;
+    mesh->verts[image[i]] = mesh->verts[i];
+    mesh->faces[image[i]] = mesh->faces[i];
+    *coord(mesh->verts + image[i], a) = -*coord(mesh->verts + i, a);
+  }
+  for (size_t t = 0; t < tris; t++) {
+    mesh->idx[(tris + t) * 3] = image[mesh->idx[t * 3]];
+    mesh->idx[(tris + t) * 3 + 1] = image[mesh->idx[t * 3 + 2]];
+    mesh->idx[(tris + t) * 3 + 2] = image[mesh->idx[t * 3 + 1]];
+  }
+  mesh->num_verts += added;
+  mesh->num_tris += tris;
+  free(image);
+}
+
+// Narrows the lattice to the positive half of every mirrored axis, meshes
+// it with region, then restores the lattice and reflects the mesh. Returns
+// 0, having done nothing, when no mirror applies.
+int mesh_symmetric(t_data *data, t_sampler sampler,
+                   void (*region)(t_data *, t_sampler)) {
+  t_fract *f = data->fract;
+  uint mirrors = lattice_mirrors(f, sampler);
+  float **grid[3] = {&f->grid.x, &f->grid.y, &f->grid.z};
+  uint *cells[3] = {&f->cells.x, &f->cells.y, &f->cells.z};
+  uint half[3];
+  double start;
+
+  if (!mirrors)
+    return 0;
+  for (int a = 0; a < 3; a++) {
+    half[a] = *cells[a] / 2;
+    if (!(mirrors & (1u << a)))
+      continue;
+    *grid[a] += half[a];
+    *cells[a] -= half[a];
+  }
+  voxel_rows(f);
+  data->mesh.keep_faces = 1;
+  region(data, sampler);
+  for (int a = 0; a < 3; a++) {
+    if (!(mirrors & (1u << a)))
+      continue;
+    *grid[a] -= half[a];
+    *cells[a] += half[a];
+  }
+  voxel_rows(f);
+  start = stats_clock(f);
+  for (int a = 0; a < 3; a++)
+    if (mirrors & (1u << a))
+      mirror_mesh(data, &data->mesh, a);
+  stats_add(f, STAGE_MERGE, start);
+  data->mesh.keep_faces = 0;
+  return 1;
+}
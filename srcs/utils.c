@@ -1,66 +1,101 @@
 #include "morphosis.h"
+#include <limits.h>
 
-float3 						**alloc_float3_arr(float3 **mem, uint2 *len)
+/*
+** Indexed mesh store: unique vertices plus three indices per triangle, each
+** in one contiguous array that grows geometrically, so appending is amortised
+** O(1) and freeing the whole mesh is a single call.
+*/
+
+void						mesh_init(t_mesh *mesh)
+{
+	mesh->verts = NULL;
+	mesh->ends = NULL;
+	mesh->faces = NULL;
+	mesh->idx = NULL;
+	mesh->num_verts = 0;
+	mesh->num_tris = 0;
+	mesh->vert_capacity = 0;
+	mesh->end_capacity = 0;
+	mesh->face_capacity = 0;
+	mesh->tri_capacity = 0;
+	mesh->keep_ends = 0;
+	mesh->keep_faces = 0;
+	mesh->allocs = 0;
+}
+
+/*
+** Counts are uint, as vertex indices are, and sizes are worked out in
+** size_t. A count past UINT_MAX, or a size past SIZE_MAX, fails like an
+** allocation would rather than wrapping to a smaller buffer. Each buffer
+** allocated or grown is counted in allocs, for the build profile.
+*/
+
+static int					grow(void **buf, uint *capacity, size_t needed,
+								size_t elem, unsigned long *allocs)
 {
-	uint 					size;
+	void					*tmp;
+	size_t					n;
+
+	if (needed <= *capacity)
+		return (1);
+	if (needed > UINT_MAX || needed > SIZE_MAX / elem)
+		return (0);
+	n = *capacity ? *capacity : MESH_MIN_CAPACITY;
+	while (n < needed)
+		n = n > UINT_MAX / 2 ? UINT_MAX : n * 2;
+	if (n > SIZE_MAX / elem)
+		n = needed;
+	if (!(tmp = realloc(*buf, n * elem)))
+		return (0);
+	(*allocs)++;
+	*buf = tmp;
+	*capacity = n;
+	return (1);
+}
 
-	size = len->x + len->y;
-	if (!size)
-		return NULL;
-	if (!mem)
-	{
-		if (!(mem = (float3 **)malloc(sizeof(float3 *) * size)))
-			return NULL;
-		for (uint c = len->x; c < size; c++)
-		{
-			if (!(mem[c] = (float3 *)malloc(3 * sizeof(float3))))
-				return NULL;
-		}
-	}
-	else
-	{
-		if (!(mem = (float3 **)realloc(mem, sizeof(float3 *) * size)))
-			return NULL;
-		for (uint c = len->x; c < size; c++)
-		{
-			if (!(mem[c] = (float3 *)malloc(3 * sizeof(float3))))
-				return NULL;
-		}
-	}
-	return mem;
+int							mesh_reserve(t_mesh *mesh, uint extra_verts,
+								uint extra_tris)
+{
+	if (!grow((void **)&mesh->verts, &mesh->vert_capacity,
+		(size_t)mesh->num_verts + extra_verts, sizeof(float3), &mesh->allocs))
+		return (0);
+	if (mesh->keep_ends && !grow((void **)&mesh->ends, &mesh->end_capacity,
+		mesh->vert_capacity, sizeof(float3), &mesh->allocs))
+		return (0);
+	if (mesh->keep_faces && !grow((void **)&mesh->faces, &mesh->face_capacity,
+		mesh->vert_capacity, sizeof(uchar), &mesh->allocs))
+		return (0);
+	return (grow((void **)&mesh->idx, &mesh->tri_capacity,
+		(size_t)mesh->num_tris + extra_tris, 3 * sizeof(uint), &mesh->allocs));
 }
 
-float3						**arr_float3_cat(float3 **f_from, float3 **f_to, uint2 *len)
+void						mesh_clear(t_mesh *mesh)
 {
-	uint					from_c;
-	uint 					to_c;
-	uint 					res_c;
+	mesh->num_verts = 0;
+	mesh->num_tris = 0;
+}
 
-	res_c = len->x + len->y;
-	from_c = 0;
-	to_c = len->x;
-	if (!(f_to = alloc_float3_arr(f_to, len)))
-		return NULL;
+void						mesh_free(t_mesh *mesh)
+{
+	free(mesh->verts);
+	free(mesh->ends);
+	free(mesh->faces);
+	free(mesh->idx);
+	mesh_init(mesh);
+}
 
-	while (to_c < res_c)
-	{
-		f_to[to_c][0] = f_from[from_c][0];
-		f_to[to_c][1] = f_from[from_c][1];
-		f_to[to_c][2] = f_from[from_c][2];
-		to_c++;
-		from_c++;
-	}
-	len->x = res_c;
+/*
+** Capacity hint: the surface crosses roughly as many cells as the faces of
+** the bounding box, at about two triangles per crossed cell. A closed
+** welded surface has about half as many vertices as triangles.
+*/
 
-	if (f_from)
-	{
-		for (uint i = 0; i < len->y; i++)
-			free(f_from[i]);
-		free(f_from);
-		f_from = NULL;
-	}
+uint						mesh_estimate(t_fract *f)
+{
+	size_t					cells;
 
-	len->y = 0;
-	f_from = NULL;
-	return f_to;
+	cells = (size_t)f->cells.x * f->cells.y + (size_t)f->cells.y * f->cells.z
+		+ (size_t)f->cells.z * f->cells.x;
+	return (cells * 4 > MESH_MAX_HINT ? MESH_MAX_HINT : (uint)(cells * 4));
 }
@@ -22,29 +22,38 @@ void 						export_obj(t_data *data)
 	obj_delete(o);
 }
 
+/*
+** The mesh is already welded, so every vertex is added once and polygons
+** refer to them by index.
+*/
+
 void						write_mesh(t_data *data, int surface, obj *o)
 {
-	float3 					**tris;
+	uint 					*idx;
 	uint 					i;
+	int						base;
 	int						polygon;
 	int 					verts[3];
 	float 					*vertex;
-	float					percent;
 
 	if (!(vertex = (float *)malloc(3 * sizeof(float))))
 		error(MALLOC_FAIL_ERR, data);
-	tris = data->triangles;
+	base = obj_num_vert(o);
+	i = 0;
+	while (i < data->mesh.num_verts)
+	{
+		fetch_vertex_coords(data->mesh.verts[i], vertex);
+		obj_set_vert_v(o, obj_add_vert(o), vertex);
+		i++;
+	}
 	i = 0;
-	while (i < data->gl->num_tris)
+	while (i < data->mesh.num_tris)
 	{
-		printf("Written: %.3f %%\n", (((float)i / data->gl->num_tris) * 100));
+		printf("Written: %.3f %%\n", (((float)i / data->mesh.num_tris) * 100));
+		idx = data->mesh.idx + (size_t)i * 3;
 		polygon = obj_add_poly(o, surface);
 		for (int v = 0; v < 3; v++)
-		{
-			verts[v] = obj_add_vert(o);
-			fetch_vertex_coords(tris[i][v], vertex);
-			obj_set_vert_v(o, verts[v], vertex);
-		}
+			verts[v] = base + (int)idx[v];
 		obj_set_poly(o, surface, polygon, verts);
 		i++;
 	}
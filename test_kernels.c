@@ -0,0 +1,211 @@
+// Numeric kernel test: every kernel set this CPU can run must sample rows
+// exactly like the scalar references sample_4D_Julia and
+// sample_4D_Julia_distance, for specialised and
+// generic iteration counts and exponents and for rows whose length is not a
+// multiple of the batch width, must sample scattered points like
+// sample_4D_Julia too, and must classify cells exactly like the
+// corner layout of define_voxel. Orbits continued in several steps must
+// escape exactly where the reference does for every count up to the last.
+//
+// Build: cc -O2 -Iincludes -Ilibft test_kernels.c srcs/kernels.c
+//        srcs/sample_julia.c srcs/lib_complex.c -o test_kernels -lm
+#include "morphosis.h"
+
+static int compare_rows(t_sampler sampler,
+                        float (*reference)(t_julia *, float3), t_julia *julia,
+                        uint n) {
+  float x[97];
+  float out[97];
+  float3 pos;
+  int mismatches = 0;
+
+  for (uint i = 0; i < n; i++)
+    x[i] = -1.2f + 2.4f * (float)i / (float)(n - 1);
+  for (pos.z = -1.2f; pos.z <= 1.2f; pos.z += 0.05f) {
+    for (pos.y = -1.2f; pos.y <= 1.2f; pos.y += 0.05f) {
+      sampler(julia, x, pos.y, pos.z, n, out);
+      for (uint i = 0; i < n; i++) {
+        pos.x = x[i];
+        if (out[i] != reference(julia, pos))
+          mismatches++;
+      }
+    }
+  }
+  return mismatches;
+}
+
+// 97 points along a spiral through the box, every lane seeing a different
+// y and z
+static int compare_points(const t_kernels *k, t_julia *julia) {
+  float x[97];
+  float y[97];
+  float z[97];
+  float out[97];
+  float3 pos;
+  int mismatches = 0;
+
+  for (uint i = 0; i < 97; i++) {
+    x[i] = 1.2f * cosf((float)i * 0.37f) * (float)i / 96.0f;
+    y[i] = 1.2f * sinf((float)i * 0.37f) * (float)i / 96.0f;
+    z[i] = -1.2f + 2.4f * (float)i / 96.0f;
+  }
+  k->sample_points(julia, x, y, z, 97, out);
+  for (uint i = 0; i < 97; i++) {
+    pos.x = x[i];
+    pos.y = y[i];
+    pos.z = z[i];
+    if (out[i] != sample_4D_Julia(julia, pos))
+      mismatches++;
+  }
+  return mismatches;
+}
+
+static int test_sampler(const t_kernels *k) {
+  const cl_quat c[4] = {{-0.2f, 0.8f, 0.0f, 0.0f},
+                        {-0.4f, 0.6f, 0.0f, 0.0f},
+                        {0.18f, 0.0f, 0.0f, 0.78f},
+                        {-0.125f, -0.256f, 0.847f, 0.0895f}};
+  const uint rows[4] = {97, 16, 8, 3};
+  const uint iters[5] = {1, 6, 10, 32, 40};
+  t_julia julia;
+  int mismatches;
+  int failed = 0;
+
+  julia.w = 0.0f;
+  julia.threshold = 2.0f;
+  for (julia.exponent = 2; julia.exponent <= 4; julia.exponent++) {
+    for (int j = 0; j < 4; j++) {
+      julia.c = c[j];
+      for (int i = 0; i < 5; i++) {
+        julia.max_iter = iters[i];
+        if ((mismatches = compare_points(k, &julia))) {
+          printf("%s: points, c %d, z^%u, %u iterations: %d mismatches\n",
+                 k->name, j, julia.exponent, iters[i], mismatches);
+          failed = 1;
+        }
+        for (int r = 0; r < 4; r++) {
+          if ((mismatches = compare_rows(k->sample_row, sample_4D_Julia,
+                                         &julia, rows[r]))) {
+            printf("%s: c %d, z^%u, %u iterations, rows of %u: %d "
+                   "mismatches\n",
+                   k->name, j, julia.exponent, iters[i], rows[r], mismatches);
+            failed = 1;
+          }
+          if ((mismatches = compare_rows(k->distance_row,
+                                         sample_4D_Julia_distance, &julia,
+                                         rows[r]))) {
+            printf("%s: distance, c %d, z^%u, %u iterations, rows of %u: %d "
+                   "mismatches\n",
+                   k->name, j, julia.exponent, iters[i], rows[r], mismatches);
+            failed = 1;
+          }
+        }
+      }
+    }
+  }
+  return failed;
+}
+
+// A row of 53 nodes iterated to 5, then 12, then 30, each stage checked
+// against the reference at its own count and at every lower one
+static int test_orbit(const t_kernels *k) {
+  const uint stages[4] = {0, 5, 12, 30};
+  float zs[4][53];
+  float *z[4] = {zs[0], zs[1], zs[2], zs[3]};
+  uint escape[53];
+  float3 pos;
+  int failed = 0;
+  t_julia julia;
+
+  julia.c = (cl_quat){-0.2f, 0.8f, 0.0f, 0.0f};
+  julia.w = 0.0f;
+  julia.threshold = 2.0f;
+  julia.exponent = 3;
+  pos.y = 0.15f;
+  pos.z = -0.35f;
+  for (uint i = 0; i < 53; i++) {
+    zs[0][i] = -1.2f + 2.4f * (float)i / 52.0f;
+    zs[1][i] = pos.y;
+    zs[2][i] = pos.z;
+    zs[3][i] = julia.w;
+    escape[i] = 0;
+  }
+  for (uint s = 1; s < 4; s++) {
+    k->orbit_row(&julia, z, escape, 53, stages[s - 1], stages[s]);
+    for (julia.max_iter = 1; julia.max_iter <= stages[s]; julia.max_iter++) {
+      for (uint i = 0; i < 53; i++) {
+        pos.x = -1.2f + 2.4f * (float)i / 52.0f;
+        if ((!escape[i] || escape[i] > julia.max_iter) !=
+            (sample_4D_Julia(&julia, pos) != 0.0f)) {
+          printf("%s: node %u after %u iterations disagrees at %u\n",
+                 k->name, i, stages[s], julia.max_iter);
+          failed = 1;
+        }
+      }
+    }
+  }
+  return failed;
+}
+
+// Two node planes of 37 x 2 nodes with unrelated inside patterns, but for
+// runs of nodes all outside and all inside, and the cells the surface
+// crosses listed in order
+static int test_classifier(const t_kernels *k) {
+  const uint dx[8] = {0, 1, 1, 0, 0, 1, 1, 0};
+  const uint dy[8] = {1, 1, 0, 0, 1, 1, 0, 0};
+  const size_t row = 37;
+  float planes[2][74];
+  uchar cube[36];
+  uint active[36];
+  uint expected;
+  uint n;
+  uint m;
+  int failed = 0;
+
+  for (uint i = 0; i < 74; i++) {
+    planes[0][i] = (float)((i * 7 + 3) % 5 < 2);
+    planes[1][i] = (float)((i * 11 + 1) % 3 == 0);
+    if (i % row < 10)
+      planes[0][i] = planes[1][i] = 0.0f;
+    else if (i % row >= 16 && i % row < 26)
+      planes[0][i] = planes[1][i] = 1.0f;
+  }
+  n = k->classify_row(planes[0], planes[1], row, 36, cube, active);
+  m = 0;
+  for (uint x = 0; x < 36; x++) {
+    if (cube[x] != 0 && cube[x] != 255 && (m >= n || active[m++] != x)) {
+      printf("%s: crossed cell %u not listed\n", k->name, x);
+      failed = 1;
+    }
+    expected = 0;
+    for (uint c = 0; c < 8; c++)
+      if (planes[c >> 2][x + dx[c] + dy[c] * row])
+        expected |= 1u << c;
+    if (cube[x] != expected) {
+      printf("%s: cell %u classified %u, expected %u\n", k->name, x, cube[x],
+             expected);
+      failed = 1;
+    }
+  }
+  if (m != n) {
+    printf("%s: %u cells listed, %u crossed\n", k->name, n, m);
+    failed = 1;
+  }
+  return failed;
+}
+
+int main(void) {
+  const t_kernels *k;
+  int failed = 0;
+
+  for (uint i = 0; i < 8; i++) {
+    if (!(k = kernels_get(i)))
+      continue;
+    printf("checking %s kernels\n", k->name);
+    failed |= test_sampler(k);
+    failed |= test_classifier(k);
+    failed |= test_orbit(k);
+  }
+  printf("%s\n", failed ? "FAILED" : "OK");
+  return failed;
+}
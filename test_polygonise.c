@@ -0,0 +1,1006 @@
+// Mesher tests: every marching-cubes case without allocating, vertex
+// placement and welding, and every way through generation (slabs, bricks,
+// surface following, culling, mirrors, fitting, packing, Morton order,
+// cancelling, the mesh cache and profiling) meshing what the plain
+// full-lattice build does.
+//
+// Build: cc -O2 -Iincludes -Ilibft test_polygonise.c -o test_polygonise -lm
+// (add -fopenmp to run the slabs on threads)
+#include "morphosis.h"
+
+static size_t alloc_count = 0;
+
+void *counted_malloc(size_t size) {
+  alloc_count++;
+  return malloc(size);
+}
+
+void *counted_calloc(size_t count, size_t size) {
+  alloc_count++;
+  return calloc(count, size);
+}
+
+void *counted_realloc(void *ptr, size_t size) {
+  alloc_count++;
+  return realloc(ptr, size);
+}
+
+// Route every allocation made by the mesher sources through the counters
+#define malloc(size) counted_malloc(size)
+#define calloc(count, size) counted_calloc(count, size)
+#define realloc(ptr, size) counted_realloc(ptr, size)
+#include "srcs/lattice.c"
+#include "srcs/polygonisation.c"
+#include "srcs/utils.c"
+#include "srcs/slab.c"
+#include "srcs/build_fractal.c"
+#include "srcs/sample_julia.c"
+#include "srcs/kernels.c"
+#include "srcs/orbit.c"
+#include "srcs/adaptive.c"
+#include "srcs/follow.c"
+#include "srcs/interval.c"
+#include "srcs/symmetry.c"
+#include "srcs/fit.c"
+#include "srcs/occupancy.c"
+#include "srcs/morton.c"
+#include "srcs/mesh_cache.c"
+#include "srcs/stats.c"
+#include "srcs/lib_complex.c"
+#undef malloc
+#undef calloc
+#undef realloc
+
+void error(int code, t_data *data) {
+  printf("error %d raised during test\n", code);
+  (void)data;
+  exit(1);
+}
+
+// Same corner layout as define_voxel
+static void set_voxels(t_fract *f) {
+  for (int c = 0; c < 8; c++) {
+    f->voxel[c].dx = (c & 3) == 1 || (c & 3) == 2;
+    f->voxel[c].dy = (c & 3) < 2;
+    f->voxel[c].dz = c >> 2;
+    f->voxel[c].offset = f->voxel[c].dx + f->voxel[c].dy * (f->cells.x + 1);
+  }
+}
+
+// Meshes f's lattice from sampler into a mesh of data's own, with the
+// samples a build of f needs
+static void build_lattice(t_data *data, t_fract *f, t_sampler sampler) {
+  data->fract = f;
+  set_voxels(f);
+  mesh_init(&data->mesh);
+  data->vertexval = (float *)malloc(lattice_nodes(f) * sizeof(float));
+  generate_lattice(data, sampler);
+  free(data->vertexval);
+  data->vertexval = NULL;
+}
+
+// Same vertices in the same order and same triangles
+static int meshes_equal(t_mesh *a, t_mesh *b) {
+  return a->num_verts == b->num_verts && a->num_tris == b->num_tris &&
+         !memcmp(a->verts, b->verts, a->num_verts * sizeof(float3)) &&
+         !memcmp(a->idx, b->idx, (size_t)a->num_tris * 3 * sizeof(uint));
+}
+
+static int test_all_cube_cases(void) {
+  float3 c_pos[8];
+  float c_val[8];
+  float3 verts[MC_MAX_VERTS];
+  uint slot[12];
+  uint *slots[12];
+  uint out[MC_MAX_TRIS * 3];
+  t_mesh mesh;
+  uint expected;
+  uint used;
+  uint n;
+  int failed = 0;
+
+  for (int c = 0; c < 8; c++) {
+    c_pos[c].x = (float)(c & 1);
+    c_pos[c].y = (float)((c >> 1) & 1);
+    c_pos[c].z = (float)(c >> 2);
+  }
+  for (int e = 0; e < 12; e++)
+    slots[e] = slot + e;
+  mesh_init(&mesh);
+  mesh.verts = verts;
+  alloc_count = 0;
+  for (uint cube = 0; cube < 256; cube++) {
+    for (int c = 0; c < 8; c++)
+      c_val[c] = (cube >> c) & 1 ? 1.0f : 0.0f;
+    memset(slot, 0xff, sizeof(slot));
+    mesh.num_verts = 0;
+    expected = (uint)(tritable[cube] >> 60);
+    used = 0;
+    for (uint i = 0; i < expected * 3; i++)
+      used |= 1u << (tritable[cube] >> (4 * i) & 15);
+    if (used != edgetable[cube] || expected > MC_MAX_TRIS) {
+      printf("cube %u: triangles use edges %03x, crossed edges are %03x\n",
+             cube, used, edgetable[cube]);
+      failed = 1;
+    }
+    n = polygonise_cell(c_pos, c_val, slots, &mesh, out);
+    if (n != expected) {
+      printf("cube %u: %u triangles, expected %u\n", cube, n, expected);
+      failed = 1;
+    }
+    for (uint i = 0; i < n * 3; i++) {
+      if (out[i] >= mesh.num_verts) {
+        printf("cube %u: index %u out of range\n", cube, out[i]);
+        failed = 1;
+      }
+    }
+  }
+  if (alloc_count) {
+    printf("polygonise_cell: %zu allocations over 256 cases\n", alloc_count);
+    failed = 1;
+  }
+  return failed;
+}
+
+// Outside corner c estimates 0.2 + 0.05 c to the surface along the normal,
+// so the vertex on each crossing edge lies that much times EDGE_OBLIQUITY
+// from it
+static int test_distance_vertices(void) {
+  float3 c_pos[8];
+  float c_val[8];
+  float3 verts[MC_MAX_VERTS];
+  uint slot[12];
+  uint *slots[12];
+  uint out[MC_MAX_TRIS * 3];
+  t_mesh mesh;
+  float3 v;
+  uint o;
+  float d;
+  int failed = 0;
+
+  for (int c = 0; c < 8; c++) {
+    c_pos[c].x = (float)(c & 1);
+    c_pos[c].y = (float)((c >> 1) & 1);
+    c_pos[c].z = (float)(c >> 2);
+  }
+  for (int e = 0; e < 12; e++)
+    slots[e] = slot + e;
+  mesh_init(&mesh);
+  mesh.verts = verts;
+  for (uint cube = 1; cube < 255; cube++) {
+    for (int c = 0; c < 8; c++)
+      c_val[c] = (cube >> c) & 1 ? 1.0f : -(0.2f + 0.05f * (float)c);
+    memset(slot, 0xff, sizeof(slot));
+    mesh.num_verts = 0;
+    polygonise_cell(c_pos, c_val, slots, &mesh, out);
+    for (int e = 0; e < 12; e++) {
+      if (slot[e] == EDGE_NONE)
+        continue;
+      o = (cube >> edge_corners[e][0]) & 1 ? edge_corners[e][1]
+                                           : edge_corners[e][0];
+      v = verts[slot[e]];
+      d = sqrtf((v.x - c_pos[o].x) * (v.x - c_pos[o].x) +
+                (v.y - c_pos[o].y) * (v.y - c_pos[o].y) +
+                (v.z - c_pos[o].z) * (v.z - c_pos[o].z));
+      if (fabsf(d + c_val[o] * EDGE_OBLIQUITY) > 1e-5f) {
+        printf("cube %u: edge %d vertex %f from its outside corner\n", cube,
+               e, d);
+        failed = 1;
+      }
+    }
+  }
+  return failed;
+}
+
+// 300 rays from the origin out of the set, more than one batch, bisected
+// six times in batches and once more here one point at a time
+static int test_refine_matches_scalar(void) {
+  t_julia julia = {8, 2, 2.0f, 0.0f, {-0.2f, 0.8f, 0.0f, 0.0f}};
+  t_mesh mesh;
+  float3 in;
+  float3 out;
+  float3 mid;
+  int failed = 0;
+
+  mesh_init(&mesh);
+  mesh.keep_ends = 1;
+  if (!mesh_reserve(&mesh, 300, 0))
+    return 1;
+  for (uint i = 0; i < 300; i++) {
+    mesh.verts[i] = (float3){0.0f, 0.0f, 0.0f};
+    mesh.ends[i] = (float3){1.5f, -1.5f + (float)i * 0.01f, 0.25f};
+  }
+  mesh.num_verts = 300;
+  refine_vertices(&julia, &mesh, 6);
+  for (uint i = 0; i < 300; i++) {
+    in = (float3){0.0f, 0.0f, 0.0f};
+    out = (float3){1.5f, -1.5f + (float)i * 0.01f, 0.25f};
+    for (int s = 0; s <= 6; s++) {
+      mid.x = 0.5f * (in.x + out.x);
+      mid.y = 0.5f * (in.y + out.y);
+      mid.z = 0.5f * (in.z + out.z);
+      if (s < 6 && sample_4D_Julia(&julia, mid) > 0.0f)
+        in = mid;
+      else if (s < 6)
+        out = mid;
+    }
+    if (memcmp(&mid, mesh.verts + i, sizeof(float3))) {
+      printf("ray %u: refined to %f %f %f, expected %f %f %f\n", i,
+             mesh.verts[i].x, mesh.verts[i].y, mesh.verts[i].z, mid.x, mid.y,
+             mid.z);
+      failed = 1;
+    }
+  }
+  mesh_free(&mesh);
+  return failed;
+}
+
+static int test_layer_without_growth(void) {
+  t_fract f;
+  t_data data;
+  float axis[9];
+  t_slab slab;
+  uchar cubes[8];
+  uint active[8];
+  float lo[81];
+  float hi[81];
+  size_t allocs;
+  uint tris;
+  uint verts;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  f.p0.x = f.p0.y = f.p0.z = -1.0f;
+  f.step_size = 0.25f;
+  f.cells.x = f.cells.y = 8;
+  f.cells.z = 1;
+  for (uint i = 0; i <= 8; i++)
+    axis[i] = -1.0f + (float)i * 0.25f;
+  f.grid.x = f.grid.y = f.grid.z = axis;
+  set_voxels(&f);
+  data.fract = &f;
+  mesh_init(&data.mesh);
+
+  // A ball of radius 0.6 cut by the two planes z = -1 and z = -0.75
+  for (uint y = 0; y <= 8; y++) {
+    for (uint x = 0; x <= 8; x++) {
+      float r2 = axis[x] * axis[x] + axis[y] * axis[y];
+      lo[y * 9 + x] = r2 + 1.0f < 1.36f ? 1.0f : 0.0f;
+      hi[y * 9 + x] = r2 + 0.5625f < 1.36f ? 1.0f : 0.0f;
+    }
+  }
+  slab.planes[0] = lo;
+  slab.planes[1] = hi;
+  slab.bits = NULL;
+  slab.mesh = &data.mesh;
+  slab.cubes = cubes;
+  slab.active = active;
+
+  if (!mesh_reserve(&data.mesh, f.cells.x * f.cells.y * MC_MAX_VERTS,
+                    f.cells.x * f.cells.y * MC_MAX_TRIS) ||
+      !edge_cache_init(&slab.edges, 81, 1))
+    return 1;
+  allocs = alloc_count;
+  for (uint y = 0; y < f.cells.y; y++)
+    polygonise_row(&f, &slab, y, 0);
+  allocs = alloc_count - allocs;
+  tris = data.mesh.num_tris;
+  verts = data.mesh.num_verts;
+  printf("layer: %u triangles, %u vertices, %zu allocations\n", tris, verts,
+         allocs);
+  edge_cache_free(&slab.edges);
+  mesh_free(&data.mesh);
+  // Unwelded output would need three vertices per triangle
+  return allocs != 0 || tris == 0 || verts * 2 > tris * 3;
+}
+
+// Counts past UINT_MAX must fail without touching the mesh
+static int test_reserve_overflow(void) {
+  t_mesh mesh;
+  int failed;
+
+  mesh_init(&mesh);
+  if (!mesh_reserve(&mesh, 16, 16))
+    return 1;
+  mesh.num_verts = mesh.num_tris = 16;
+  failed = mesh_reserve(&mesh, UINT_MAX, 0) ||
+           mesh_reserve(&mesh, 0, UINT_MAX - 8) ||
+           mesh.vert_capacity < 16 || mesh.tri_capacity < 16;
+  mesh_free(&mesh);
+  if (failed)
+    printf("mesh_reserve accepted a count past UINT_MAX\n");
+  return failed;
+}
+
+// Off-centre blob that crosses every slab boundary
+static void blob(t_julia *julia, const float *x, float y, float z, uint n,
+                 float *out) {
+  float px;
+
+  (void)julia;
+  for (uint i = 0; i < n; i++) {
+    px = x[i] - 0.1f;
+    out[i] = px * px + 1.5f * y * y + z * z * (1.0f + px) < 0.6f;
+  }
+}
+
+static int test_slabs_match_serial(void) {
+  const uint threads[3] = {2, 5, 12};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[13];
+  t_mesh serial;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  f.cells.x = f.cells.y = f.cells.z = 12;
+  for (uint i = 0; i <= 12; i++)
+    axis[i] = -1.0f + (float)i / 6.0f;
+  f.grid.x = f.grid.y = f.grid.z = axis;
+  data.gl = &gl;
+  f.threads = 1;
+  build_lattice(&data, &f, blob);
+  serial = data.mesh;
+  for (int stream = 0; stream < 2; stream++) {
+    for (int t = 0; t < 3; t++) {
+      f.stream = stream;
+      f.threads = threads[t];
+      build_lattice(&data, &f, blob);
+      if (!meshes_equal(&data.mesh, &serial)) {
+        printf("%u slabs%s: mesh differs from serial run\n", threads[t],
+               stream ? " (stream)" : "");
+        failed = 1;
+      }
+      mesh_free(&data.mesh);
+    }
+  }
+  printf("slabs: %u triangles, %u vertices\n", serial.num_tris,
+         serial.num_verts);
+  failed |= serial.num_tris == 0;
+  mesh_free(&serial);
+  return failed;
+}
+
+// Lattices of 24 and 23 cells, the second clipping the last brick on each
+// axis, sampled from bricks of 4 and 8 cells (1 turns bricks off) and
+// followed from seed lines 4 and 7 cells apart
+static int test_sparse_matches_full(void) {
+  const uint cells[2] = {24, 23};
+  const uint bricks[5] = {1, 4, 8, 0, 0};
+  const uint seeds[5] = {0, 0, 0, 4, 7};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[25];
+  t_mesh full;
+  int failed = 0;
+
+  memset(&data, 0, sizeof(data));
+  data.gl = &gl;
+  for (int l = 0; l < 2; l++) {
+    memset(&f, 0, sizeof(f));
+    f.cells.x = f.cells.y = f.cells.z = cells[l];
+    for (uint i = 0; i <= cells[l]; i++)
+      axis[i] = -1.0f + 2.0f * (float)i / (float)cells[l];
+    f.grid.x = f.grid.y = f.grid.z = axis;
+    f.guard = 1;
+    build_lattice(&data, &f, blob);
+    full = data.mesh;
+    for (int b = 0; b < 5; b++) {
+      f.brick = bricks[b];
+      f.follow = seeds[b];
+      build_lattice(&data, &f, blob);
+      if (!meshes_equal(&data.mesh, &full)) {
+        printf("%u cells, bricks of %u, seeds %u apart: mesh differs from "
+               "full sampling\n",
+               cells[l], bricks[b], seeds[b]);
+        failed = 1;
+      }
+      mesh_free(&data.mesh);
+    }
+    failed |= full.num_tris == 0;
+    mesh_free(&full);
+  }
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+// Binary and distance samples of two sets, z^2 and z^3, culled from bricks
+// of 2, 3 and 8 cells; some bricks must be decided for the test to mean
+// anything
+static int test_cull_matches_full(void) {
+  const cl_quat c[2] = {{-0.2f, 0.8f, 0.0f, 0.0f}, {0.18f, 0.0f, 0.0f, 0.78f}};
+  const uint sizes[3] = {2, 3, 8};
+  t_julia julia = {10, 2, 2.0f, 0.0f, {0.0f, 0.0f, 0.0f, 0.0f}};
+  t_sampler samplers[2] = {sample_4D_Julia_row, sample_4D_Julia_distance_row};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[31];
+  t_mesh full;
+  size_t decided = 0;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  f.cells.x = f.cells.y = f.cells.z = 30;
+  for (uint i = 0; i <= 30; i++)
+    axis[i] = -1.5f + (float)i * 0.1f;
+  f.grid.x = f.grid.y = f.grid.z = axis;
+  f.julia = &julia;
+  data.gl = &gl;
+  for (int k = 0; k < 4; k++) {
+    julia.c = c[k & 1];
+    julia.exponent = 2 + (k >> 1);
+    for (int s = 0; s < 2; s++) {
+      f.cull = 0;
+      build_lattice(&data, &f, samplers[s]);
+      full = data.mesh;
+      for (int b = 0; b < 3; b++) {
+        f.cull = sizes[b];
+        build_lattice(&data, &f, samplers[s]);
+        for (size_t i = 0; f.culled.state && i < (size_t)f.culled.count.x *
+                                                     f.culled.count.y *
+                                                     f.culled.count.z;
+             i++)
+          decided += f.culled.state[i] != 0;
+        if (!meshes_equal(&data.mesh, &full)) {
+          printf("set %d, z^%u, %s samples, bricks of %u: mesh differs "
+                 "after culling\n",
+                 k & 1, julia.exponent, s ? "distance" : "binary", sizes[b]);
+          failed = 1;
+        }
+        mesh_free(&data.mesh);
+      }
+      mesh_free(&full);
+    }
+  }
+  printf("cull: %zu bricks decided\n", decided);
+  free(f.culled.state);
+  orbit_free(&data.orbit);
+  return failed || !decided;
+}
+
+static int directed_order(const void *a, const void *b) {
+  unsigned long long i = *(const unsigned long long *)a;
+  unsigned long long j = *(const unsigned long long *)b;
+
+  return (i > j) - (i < j);
+}
+
+// Edges of a closed, consistently wound mesh each appear once in either
+// direction; 0 if so
+static int open_edges(t_mesh *mesh) {
+  size_t n = (size_t)mesh->num_tris * 3;
+  unsigned long long *e;
+  unsigned long long r;
+  int open = 0;
+
+  if (!(e = (unsigned long long *)malloc((n ? n : 1) * sizeof(*e))))
+    return 1;
+  for (size_t t = 0; t < n; t += 3)
+    for (int k = 0; k < 3; k++)
+      e[t + k] = (unsigned long long)mesh->idx[t + k] << 32 |
+                 mesh->idx[t + (k + 1) % 3];
+  qsort(e, n, sizeof(*e), directed_order);
+  for (size_t i = 0; i < n; i++) {
+    r = e[i] << 32 | e[i] >> 32;
+    if ((i && e[i] == e[i - 1]) ||
+        !bsearch(&r, e, n, sizeof(*e), directed_order))
+      open++;
+  }
+  free(e);
+  return open;
+}
+
+// The three presets of the GUI, mirrored in z, in all three axes, and in y
+// and z, on a lattice of 30 cells whose nodes mirror exactly. Cubes and
+// higher powers do not sample mirrored nodes alike and get no mirrors.
+static int test_symmetry_closed(void) {
+  const cl_quat c[3] = {{-0.2f, 0.8f, 0.0f, 0.0f},
+                        {-0.4f, 0.6f, 0.0f, 0.0f},
+                        {0.18f, 0.0f, 0.0f, 0.78f}};
+  const uint expected[3] = {4, 4, 7};
+  t_julia julia = {8, 2, 2.0f, 0.0f, {0.0f, 0.0f, 0.0f, 0.0f}};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[31];
+  uint full;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  f.cells.x = f.cells.y = f.cells.z = 30;
+  for (uint i = 0; i <= 30; i++)
+    axis[i] = (float)((int)(2 * i) - 30) * 0.05f;
+  f.grid.x = f.grid.y = f.grid.z = axis;
+  f.julia = &julia;
+  data.gl = &gl;
+  for (int k = 0; k < 3; k++) {
+    julia.c = c[k];
+    f.symmetry = 0;
+    build_lattice(&data, &f, sample_4D_Julia_row);
+    full = data.mesh.num_tris;
+    mesh_free(&data.mesh);
+    f.symmetry = 1;
+    build_lattice(&data, &f, sample_4D_Julia_row);
+    if (lattice_mirrors(&f, sample_4D_Julia_row) != expected[k] ||
+        data.mesh.num_tris != full || !full || open_edges(&data.mesh) ||
+        f.cells.z != 30 || f.grid.z != axis) {
+      printf("preset %d: mirrors %u, %u triangles against %u, %d open "
+             "edges\n",
+             k, lattice_mirrors(&f, sample_4D_Julia_row), data.mesh.num_tris,
+             full, open_edges(&data.mesh));
+      failed = 1;
+    }
+    mesh_free(&data.mesh);
+  }
+  for (julia.exponent = 3; julia.exponent <= 4; julia.exponent++) {
+    if (set_mirrors(&f, sample_4D_Julia_row)) {
+      printf("exponent %u: mirrors used\n", julia.exponent);
+      failed = 1;
+    }
+  }
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+// Auto-fitting a lattice of 30 cells from every second and third node must
+// narrow it and mesh the sets exactly as the whole lattice does, and a
+// symmetric set must keep its mirrors
+static int test_fit_matches_full(void) {
+  const cl_quat c[2] = {{-0.2f, 0.6f, 0.2f, 0.2f}, {0.18f, 0.0f, 0.0f, 0.78f}};
+  t_julia julia = {10, 2, 2.0f, 0.0f, {0.0f, 0.0f, 0.0f, 0.0f}};
+  t_sampler samplers[2] = {sample_4D_Julia_row, sample_4D_Julia_distance_row};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[3][31];
+  t_mesh full;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  f.grid.x = axis[0];
+  f.grid.y = axis[1];
+  f.grid.z = axis[2];
+  f.julia = &julia;
+  f.symmetry = 1;
+  data.gl = &gl;
+  for (int k = 0; k < 4; k++) {
+    julia.c = c[k & 1];
+    for (uint h = 2; h <= 3; h++) {
+      for (int a = 0; a < 3; a++)
+        for (uint i = 0; i <= 30; i++)
+          axis[a][i] = (float)((int)(2 * i) - 30) * 0.05f;
+      f.cells.x = f.cells.y = f.cells.z = 30;
+      f.distance = k >> 1;
+      f.fit = 0;
+      build_lattice(&data, &f, samplers[k >> 1]);
+      full = data.mesh;
+      f.fit = h;
+      fit_lattice(&data);
+      build_lattice(&data, &f, samplers[k >> 1]);
+      if (f.cells.x + f.cells.y + f.cells.z >= 90 ||
+          lattice_mirrors(&f, samplers[k >> 1]) !=
+              set_mirrors(&f, samplers[k >> 1]) ||
+          !meshes_equal(&data.mesh, &full)) {
+        printf("set %d, %s samples, fitted from every %u nodes to %u x %u x "
+               "%u cells: mesh differs\n",
+               k & 1, k >> 1 ? "distance" : "binary", h, f.cells.x, f.cells.y,
+               f.cells.z);
+        failed = 1;
+      }
+      mesh_free(&full);
+      mesh_free(&data.mesh);
+    }
+  }
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+// Packed occupancy must mesh the binary samples exactly as the float
+// lattice does, on rows ending inside, at and past a 64-bit word, on one
+// slab and on three
+static int test_packed_matches_float(void) {
+  const uint widths[3] = {63, 64, 70};
+  t_julia julia = {8, 2, 2.0f, 0.0f, {-0.2f, 0.6f, 0.2f, 0.2f}};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[71];
+  t_mesh full;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  f.grid.y = f.grid.z = axis + 20;
+  f.cells.y = f.cells.z = 30;
+  f.julia = &julia;
+  data.gl = &gl;
+  for (int k = 0; k < 6; k++) {
+    f.cells.x = widths[k % 3];
+    for (uint i = 0; i <= f.cells.x; i++)
+      axis[i] = -1.5f + (float)i * 0.1f;
+    f.grid.x = axis + (70 - f.cells.x) / 2;
+    f.threads = k < 3 ? 1 : 3;
+    f.packed = 0;
+    build_lattice(&data, &f, sample_4D_Julia_row);
+    full = data.mesh;
+    f.packed = 1;
+    build_lattice(&data, &f, sample_4D_Julia_row);
+    if (!full.num_tris || !meshes_equal(&data.mesh, &full)) {
+      printf("packed %u cells wide on %u threads: %u triangles against "
+             "%u\n",
+             f.cells.x, f.threads, data.mesh.num_tris, full.num_tris);
+      failed = 1;
+    }
+    mesh_free(&full);
+    mesh_free(&data.mesh);
+  }
+  free(data.occupied);
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+static int triangle_order(const void *a, const void *b) {
+  return memcmp(a, b, 3 * sizeof(float3));
+}
+
+// Triangles by vertex position, each turned to start at its least vertex
+// and all sorted, which leaves the same array for the same surface however
+// it was meshed
+static float3 *sorted_triangles(t_mesh *mesh) {
+  float3 *t;
+  uint k;
+
+  if (!(t = (float3 *)malloc(((size_t)mesh->num_tris * 3 + 1) *
+                             sizeof(float3))))
+    return NULL;
+  for (size_t i = 0; i < mesh->num_tris; i++) {
+    k = 0;
+    for (uint j = 1; j < 3; j++)
+      if (memcmp(mesh->verts + mesh->idx[i * 3 + j],
+                 mesh->verts + mesh->idx[i * 3 + k], sizeof(float3)) < 0)
+        k = j;
+    for (uint j = 0; j < 3; j++)
+      t[i * 3 + j] = mesh->verts[mesh->idx[i * 3 + (k + j) % 3]];
+  }
+  qsort(t, mesh->num_tris, 3 * sizeof(float3), triangle_order);
+  return t;
+}
+
+// Average cache misses per triangle of a FIFO vertex cache of size entries
+static float cache_misses(t_mesh *mesh, uint size) {
+  uint *at;
+  uint clock;
+  size_t misses;
+
+  if (!(at = (uint *)calloc(mesh->num_verts + 1, sizeof(uint))))
+    return 3.0f;
+  clock = size;
+  misses = 0;
+  for (size_t i = 0; i < (size_t)mesh->num_tris * 3; i++) {
+    if (clock - at[mesh->idx[i]] >= size) {
+      at[mesh->idx[i]] = clock++;
+      misses++;
+    }
+  }
+  free(at);
+  return (float)misses / (float)mesh->num_tris;
+}
+
+static void morton_mesh(t_data *data, uint morton, uint threads) {
+  data->fract->morton = morton;
+  data->fract->threads = threads;
+  build_lattice(data, data->fract, lattice_sampler(data->fract));
+}
+
+// Bricks that divide the lattice and bricks that do not, on float and packed
+// lattices and a mirrored one, on one thread and three
+static int test_morton_matches_rows(void) {
+  const uint bricks[3] = {1, 4, 7};
+  t_julia julia = {8, 2, 2.0f, 0.0f, {-0.2f, 0.6f, 0.2f, 0.2f}};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[3][41];
+  t_mesh rows;
+  t_mesh one;
+  float3 *want;
+  float3 *got;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  for (uint i = 0; i <= 40; i++)
+    axis[0][i] = axis[1][i] = axis[2][i] = -1.5f + (float)i * 0.075f;
+  f.grid.x = axis[0];
+  f.grid.y = axis[1] + 5;
+  f.grid.z = axis[2] + 3;
+  f.cells.x = 40;
+  f.cells.y = 30;
+  f.cells.z = 33;
+  f.julia = &julia;
+  data.fract = &f;
+  data.gl = &gl;
+  set_voxels(&f);
+  for (int k = 0; k < 9; k++) {
+    f.packed = k % 3 == 1;
+    f.symmetry = k % 3 == 2;
+    julia.c.y = k % 3 == 2 ? 0.0f : 0.6f;
+    morton_mesh(&data, 0, 1);
+    rows = data.mesh;
+    morton_mesh(&data, bricks[k / 3], 1);
+    one = data.mesh;
+    morton_mesh(&data, bricks[k / 3], 3);
+    want = sorted_triangles(&rows);
+    got = sorted_triangles(&data.mesh);
+    if (!want || !got || !rows.num_tris ||
+        data.mesh.num_verts != rows.num_verts ||
+        data.mesh.num_tris != rows.num_tris ||
+        memcmp(want, got, (size_t)rows.num_tris * 3 * sizeof(float3)) ||
+        open_edges(&data.mesh) || !meshes_equal(&one, &data.mesh)) {
+      printf("bricks of %u, case %d: %u triangles against %u\n",
+             bricks[k / 3], k % 3, data.mesh.num_tris, rows.num_tris);
+      failed = 1;
+    }
+    if (bricks[k / 3] == 4 &&
+        !(cache_misses(&data.mesh, 32) < cache_misses(&rows, 32))) {
+      printf("bricks of 4, case %d: %.3f cache misses per triangle against "
+             "%.3f\n",
+             k % 3, cache_misses(&data.mesh, 32), cache_misses(&rows, 32));
+      failed = 1;
+    }
+    free(want);
+    free(got);
+    mesh_free(&rows);
+    mesh_free(&one);
+    mesh_free(&data.mesh);
+  }
+  free(data.occupied);
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+// Every way through generation, cancelled before it starts, then again
+// uncancelled, which must match a build that was never cancelled. The
+// orbit cache must not claim the iterations a cancelled build skipped.
+static int test_cancel_leaves_no_mesh(void) {
+  t_julia julia = {8, 2, 2.0f, 0.0f, {-0.2f, 0.6f, 0.2f, 0.2f}};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[41];
+  t_mesh want;
+  int cancel;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  for (uint i = 0; i <= 40; i++)
+    axis[i] = -1.5f + (float)i * 0.075f;
+  f.grid.x = f.grid.y = f.grid.z = axis;
+  f.cells.x = f.cells.y = f.cells.z = 40;
+  f.julia = &julia;
+  f.threads = 3;
+  f.orbits = 1;
+  data.fract = &f;
+  data.gl = &gl;
+  set_voxels(&f);
+  for (int k = 0; k < 6; k++) {
+    f.stream = k == 1;
+    f.follow = k == 2 ? 4 : 0;
+    f.morton = k == 3 ? 8 : 0;
+    f.packed = k == 4;
+    julia.max_iter = k == 5 ? 12 : 8;
+    f.cancel = NULL;
+    orbit_free(&data.orbit);
+    morton_mesh(&data, f.morton, f.threads);
+    want = data.mesh;
+    if (k == 5) {
+      orbit_free(&data.orbit);
+      julia.max_iter = 8;
+      morton_mesh(&data, f.morton, f.threads);
+      mesh_free(&data.mesh);
+      julia.max_iter = 12;
+    }
+    cancel = 1;
+    f.cancel = &cancel;
+    morton_mesh(&data, f.morton, f.threads);
+    if (data.mesh.num_tris || gl.num_tris) {
+      printf("cancelled case %d left %u triangles\n", k, data.mesh.num_tris);
+      failed = 1;
+    }
+    mesh_free(&data.mesh);
+    cancel = 0;
+    morton_mesh(&data, f.morton, f.threads);
+    if (!want.num_tris || !meshes_equal(&data.mesh, &want)) {
+      printf("case %d after a cancelled build: %u triangles against %u\n", k,
+             data.mesh.num_tris, want.num_tris);
+      failed = 1;
+    }
+    mesh_free(&want);
+    mesh_free(&data.mesh);
+  }
+  free(data.occupied);
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+static void cache_build(t_data *data, uint iter) {
+  data->fract->julia->max_iter = iter;
+  morton_mesh(data, 0, 1);
+  free(data->gl->tris);
+  data->gl->num_pts = data->mesh.num_verts * 3;
+  data->gl->num_tris = data->mesh.num_tris;
+  data->gl->tris = (float *)malloc(data->gl->num_pts * sizeof(float));
+  memcpy(data->gl->tris, data->mesh.verts, data->gl->num_pts * sizeof(float));
+}
+
+static int cache_holds(t_data *data, t_mesh *mesh, uint iter) {
+  data->fract->julia->max_iter = iter;
+  if (!mesh_cache_fetch(&data->cache, data->fract, data))
+    return 0;
+  return meshes_equal(&data->mesh, mesh) &&
+         data->gl->num_tris == mesh->num_tris &&
+         data->gl->num_pts == mesh->num_verts * 3 &&
+         !memcmp(data->gl->tris, mesh->verts,
+                 mesh->num_verts * sizeof(float3));
+}
+
+// Room for all three meshes but one byte: storing the third drops the one
+// least recently stored or fetched, whatever the order they came in
+static int test_mesh_cache_lru(void) {
+  const uint iters[3] = {6, 8, 10};
+  t_julia julia = {8, 2, 2.0f, 0.0f, {-0.2f, 0.6f, 0.2f, 0.2f}};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  float axis[41];
+  t_mesh built[3];
+  size_t limit = 0;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  memset(&gl, 0, sizeof(gl));
+  for (uint i = 0; i <= 40; i++)
+    axis[i] = -1.5f + (float)i * 0.075f;
+  f.cells.x = f.cells.y = f.cells.z = 40;
+  if (!grid_copy(&f.grid, &(t_grid){axis, axis, axis}, f.cells)) {
+    printf("out of memory\n");
+    return 1;
+  }
+  f.julia = &julia;
+  data.fract = &f;
+  data.gl = &gl;
+  set_voxels(&f);
+  for (int k = 0; k < 3; k++) {
+    cache_build(&data, iters[k]);
+    built[k] = data.mesh;
+    limit += mesh_bytes(&data);
+  }
+  mesh_init(&data.mesh);
+  mesh_cache_init(&data.cache, limit - 1);
+  for (int k = 0; k < 3; k++) {
+    cache_build(&data, iters[k]);
+    mesh_cache_store(&data.cache, &f, &data);
+    mesh_free(&data.mesh);
+    if (k == 1 && !cache_holds(&data, built, iters[0])) {
+      printf("mesh cache lost the first mesh\n");
+      failed = 1;
+    }
+    mesh_free(&data.mesh);
+  }
+  if (cache_holds(&data, built + 1, iters[1]) ||
+      !cache_holds(&data, built, iters[0]) ||
+      !cache_holds(&data, built + 2, iters[2])) {
+    printf("mesh cache kept the wrong meshes\n");
+    failed = 1;
+  }
+  if (memcmp(f.grid.x, axis, sizeof(axis)) ||
+      memcmp(f.grid.y, axis, sizeof(axis)) ||
+      memcmp(f.grid.z, axis, sizeof(axis))) {
+    printf("mesh cache gave back the wrong lattice axes\n");
+    failed = 1;
+  }
+  if (data.cache.len != 2 || data.cache.evictions != 1 ||
+      data.cache.hits != 3 || data.cache.misses != 1 ||
+      data.cache.bytes > data.cache.limit) {
+    printf("mesh cache: %u meshes, %lu evicted, %lu hits, %lu misses\n",
+           data.cache.len, data.cache.evictions, data.cache.hits,
+           data.cache.misses);
+    failed = 1;
+  }
+  mesh_cache_limit(&data.cache, 0);
+  if (data.cache.len || data.cache.bytes) {
+    printf("mesh cache kept %u meshes with no room\n", data.cache.len);
+    failed = 1;
+  }
+  for (int k = 0; k < 3; k++)
+    mesh_free(built + k);
+  mesh_cache_free(&data.cache);
+  mesh_free(&data.mesh);
+  free(gl.tris);
+  grid_free(&f.grid);
+  orbit_free(&data.orbit);
+  return failed;
+}
+
+// Whole lattice, streamed and packed, each node sampled exactly once: the
+// orbit cache is emptied first, which would otherwise answer every node
+static int test_stats_count_build(void) {
+  t_julia julia = {8, 2, 2.0f, 0.0f, {-0.2f, 0.6f, 0.2f, 0.2f}};
+  t_fract f;
+  t_data data;
+  t_gl gl;
+  t_stats stats;
+  float axis[41];
+  t_mesh plain;
+  int failed = 0;
+
+  memset(&f, 0, sizeof(f));
+  memset(&data, 0, sizeof(data));
+  for (uint i = 0; i <= 40; i++)
+    axis[i] = -1.5f + (float)i * 0.075f;
+  f.grid.x = f.grid.y = f.grid.z = axis;
+  f.cells.x = f.cells.y = f.cells.z = 40;
+  f.julia = &julia;
+  data.fract = &f;
+  data.gl = &gl;
+  set_voxels(&f);
+  for (int k = 0; k < 3; k++) {
+    f.stream = k == 1;
+    f.packed = k == 2;
+    f.stats = NULL;
+    morton_mesh(&data, 0, 1);
+    plain = data.mesh;
+    mesh_init(&data.mesh);
+    orbit_free(&data.orbit);
+    f.stats = &stats;
+    stats_start(&f, &data);
+    morton_mesh(&data, 0, 1);
+    stats_finish(&f, &data);
+    if (!meshes_equal(&data.mesh, &plain) || stats.evals != 41 * 41 * 41 ||
+        stats.tris != plain.num_tris || !stats.ns[STAGE_SAMPLE] ||
+        !stats.ns[STAGE_CLASSIFY] || !stats.ns[STAGE_EMIT] ||
+        !(stats.seconds > 0.0) || !stats.allocs ||
+        stats.allocs != data.mesh.allocs) {
+      printf("profiled case %d: %llu evaluations, %u triangles against %u, "
+             "%lu allocations\n",
+             k, stats.evals, stats.tris, plain.num_tris, stats.allocs);
+      failed = 1;
+    }
+    mesh_free(&plain);
+    mesh_free(&data.mesh);
+    orbit_free(&data.orbit);
+  }
+  free(data.occupied);
+  return failed;
+}
+
+int main(void) {
+  int failed = 0;
+
+  failed |= test_all_cube_cases();
+  failed |= test_distance_vertices();
+  failed |= test_refine_matches_scalar();
+  failed |= test_layer_without_growth();
+  failed |= test_reserve_overflow();
+  failed |= test_slabs_match_serial();
+  failed |= test_sparse_matches_full();
+  failed |= test_cull_matches_full();
+  failed |= test_symmetry_closed();
+  failed |= test_fit_matches_full();
+  failed |= test_packed_matches_float();
+  failed |= test_morton_matches_rows();
+  failed |= test_cancel_leaves_no_mesh();
+  failed |= test_mesh_cache_lru();
+  failed |= test_stats_count_build();
+  printf("%s\n", failed ? "FAILED" : "OK");
+  return failed;
+}